@@ -53,6 +53,38 @@ static inline uint32_t get_cpu_cycles(void)
     return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
 }
 
+/* ...retrieve monotonic time in nanoseconds (no wrap-around) */
+static inline uint64_t get_time_nsec(void)
+{
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* ...retrieve raw CPU counter (monotonic nanoseconds where not accessible) */
+static inline uint64_t get_cpu_counter(void)
+{
+#if defined(__aarch64__)
+    uint64_t            v;
+
+    /* ...generic timer virtual count; barrier keeps it from being read early */
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (v) :: "memory");
+
+    return v;
+#elif defined(__x86_64__) || defined(__i386__)
+    uint32_t            lo, hi;
+
+    /* ...serialize against preceding instructions; counter is not read early */
+    __asm__ __volatile__("lfence; rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return get_time_nsec();
+#endif
+}
+
 static inline uint32_t get_time_usec(void)
 {
     struct timespec     ts;
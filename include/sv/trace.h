@@ -308,27 +308,36 @@ while (0)
 #define __SV_DEBUG_DIR "/tmp/"
 #endif
 
+/* ...maximal size of a captured sample */
+#define SV_CAPTURE_SAMPLE_MAX           8
+
+/* ...capture stream descriptor (one per tag) */
+typedef struct sv_capture_tag
+{
+    /* ...output file name */
+    const char         *name;
+
+    /* ...stream index assigned on first sample (0 - not registered yet) */
+    int                 id;
+
+}   sv_capture_tag_t;
+
+/* ...put sample into calling thread ring (written to a file by flusher thread) */
+extern void sv_capture_write(sv_capture_tag_t *tag, const void *data, uint32_t size);
+
+/* ...write out all captured samples */
+extern void sv_capture_flush(void);
+
 /* ...capturing tag definition */
 #define __CAPTURE_TAG_EX(tag, type)                                         \
 __attribute__((unused)) static void sv_capture_##tag (type x)               \
 {                                                                           \
-    static  FILE *f = NULL;                                                 \
+    static sv_capture_tag_t __tag = { __SV_DEBUG_DIR #tag "." #type, 0 };   \
                                                                             \
-    /* ...open file as needed */                                            \
-    if (!f && (f = fopen(__SV_DEBUG_DIR #tag "." #type, "wb")) == NULL)     \
-    {                                                                       \
-        TRACE(ERROR, _x("failed to open tag file " #tag ": %m"));           \
-    }                                                                       \
+    (void)sizeof(char[sizeof(type) > SV_CAPTURE_SAMPLE_MAX ? -1 : 1]);      \
                                                                             \
-    /* ...write portion of data */                                          \
-    if (fwrite((void*)&x, sizeof(type), 1, f) != 1)                         \
-    {                                                                       \
-        TRACE(ERROR, _x("couldn't write into "#tag ": %m"));                \
-    }                                                                       \
-    else                                                                    \
-    {                                                                       \
-        fflush(f);                                                          \
-    }                                                                       \
+    /* ...no file access from a capturing thread */                         \
+    sv_capture_write(&__tag, &x, sizeof(type));                             \
 }
 
 /*******************************************************************************
@@ -344,43 +353,73 @@ __attribute__((unused)) static void sv_capture_##tag (type x)               \
 #define PM_CFG(tag)                                     \
     (__SV_PM_##tag)
 
-/* ...performance monitor command */
+/* ...performance monitor command (0 - open scope, 1 - close innermost scope) */
 #define PM(tag, cmd)                    \
     (void)(SV_PM && __SV_PM_##tag ? __PM(tag, cmd) : 0)
 
+/* ...performance monitor scope closed on leaving enclosing block */
+#define PM_SCOPE(tag)                                                       \
+    __attribute__((unused, cleanup(__sv_pm_close_##tag)))                   \
+    int __sv_pm_scope_##tag = (SV_PM && __SV_PM_##tag ? __PM(tag, 0), 1 : 0)
+
 /*******************************************************************************
  * Performance monitoring
  ******************************************************************************/
 
+/* ...maximal nesting of scopes of a tag within a thread */
+#define SV_PM_DEPTH                     8
+
+#ifndef SV_PM_CYCLES
+#define SV_PM_CYCLES                    0
+#endif
+
+/* ...calibrate raw CPU counter (blocks for a while; call before measurements start) */
+extern void sv_pm_init(void);
+
+/* ...convert raw CPU counter delta into nanoseconds (never blocks) */
+extern uint64_t sv_pm_cycles_to_nsec(uint64_t cycles);
+
+/* ...performance monitor initialization (no-op unless raw counters are used) */
+#define PM_INIT()                       \
+    (void)(SV_PM && SV_PM_CYCLES ? sv_pm_init(), 0 : 0)
+
+/* ...scope stamp and its conversion into nanoseconds */
+#if SV_PM_CYCLES
+#define __pm_stamp()                    get_cpu_counter()
+#define __pm_nsec(d)                    sv_pm_cycles_to_nsec(d)
+#else
+#define __pm_stamp()                    get_time_nsec()
+#define __pm_nsec(d)                    (d)
+#endif
+
 /* ...performance counter setting */
 #define __PM(tag, cmd)                  \
     sv_pm_##tag(cmd)
 
-/* ...performance counter tag definition */
-#define __PM_TAG_EX(tag)                                        \
-CAPTURE_TAG(PM_##tag, uint32_t, 1);                             \
-__attribute__((unused)) static void sv_pm_##tag(int cmd)        \
-{                                                               \
-    static uint32_t delta = 0;                                  \
-    u32             ts;                                         \
-                                                                \
-    /* ...get the timestamp */                                  \
-    ts = get_cpu_cycles();                                    \
-                                                                \
-    /* ...process particular command type */                    \
-    if (cmd)                                                    \
-    {                                                           \
-        /* ...calculate delta */                                \
-        delta = ts - delta;                                     \
-                                                                \
-        /* ...save the processing time */                       \
-        __CAPTURE(PM_##tag, delta);                             \
-    }                                                           \
-    else                                                        \
-    {                                                           \
-        /* ...save timestamp */                                 \
-        delta = ts;                                             \
-    }                                                           \
+/* ...performance counter tag definition (per-thread stack of 64-bit stamps) */
+#define __PM_TAG_EX(tag)                                                \
+CAPTURE_TAG(PM_##tag, uint64_t, 1);                                     \
+__attribute__((unused)) static void sv_pm_##tag(int cmd)                \
+{                                                                       \
+    static __thread uint64_t    stamp[SV_PM_DEPTH];                     \
+    static __thread int         depth;                                  \
+    uint64_t                    ts = __pm_stamp();                      \
+                                                                        \
+    if (cmd == 0)                                                       \
+    {                                                                   \
+        /* ...open scope; too deep nesting is tracked but not timed */  \
+        (depth < SV_PM_DEPTH ? stamp[depth] = ts : 0), depth++;         \
+    }                                                                   \
+    else if (depth > 0 && --depth < SV_PM_DEPTH)                        \
+    {                                                                   \
+        /* ...save processing time of innermost scope (nsec) */         \
+        __CAPTURE(PM_##tag, __pm_nsec(ts - stamp[depth]));              \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+__attribute__((unused)) static inline void __sv_pm_close_##tag(int *on) \
+{                                                                       \
+    (*on ? __PM(tag, 1) : (void)0);                                     \
 }
 
 /*******************************************************************************
@@ -34,6 +34,7 @@
 #include "common.h"
 #include "display.h"
 #include "main.h"
+#include "overlay.h"
 #include "vsink.h"
 
 /*******************************************************************************
@@ -43,6 +44,8 @@
 typedef struct app_data     app_data_t;
 typedef struct track_desc   track_desc_t;
 typedef struct track_list   track_list_t;
+typedef struct event_recorder   event_recorder_t;
+typedef struct stream_rate      stream_rate_t;
 
 /*******************************************************************************
  * Local types definitions
@@ -52,9 +55,73 @@ enum streaming_pipeline_state
     DISABLED = 0,
     STREAMING = 1,
     RECORDING = 2,
-    COMBINED = 3
+    COMBINED = 3,
+    EVENT = 4,
+
+    /* ...commands that do not change pipeline state */
+    EVENT_TRIGGER = 16
+};
+
+/* ...control socket request types */
+enum stream_control_type
+{
+    /* ...switch pipeline state or trigger event (value - streaming_pipeline_state) */
+    STREAM_CTL_STATE = 1,
+
+    /* ...start (value != 0) or stop feeding a camera branch */
+    STREAM_CTL_CAMERA = 2,
+
+    /* ...set encoder bitrate of a camera (-1 - all cameras; value - bit/s) */
+    STREAM_CTL_BITRATE = 3,
+
+    /* ...set file name of subsequent recordings (path) */
+    STREAM_CTL_RECORD_PATH = 4,
+
+    /* ...switch track (value: 1 - next, -1 - previous, 0 - restart) */
+    STREAM_CTL_TRACK = 5,
+
+    /* ...query state and statistics only */
+    STREAM_CTL_STATS = 6,
 };
 
+/* ...control socket request (one per SOCK_SEQPACKET message) */
+typedef struct stream_control_msg
+{
+    /* ...request type */
+    u32                 type;
+
+    /* ...camera index */
+    s32                 camera;
+
+    /* ...request argument */
+    s32                 value;
+
+    /* ...zero-terminated path argument */
+    char                path[256];
+
+}   stream_control_msg_t;
+
+/* ...control socket response (sent for every request) */
+typedef struct stream_control_reply
+{
+    /* ...request status (0 or negative error code) */
+    s32                 status;
+
+    /* ...current pipeline state */
+    u32                 state;
+
+    /* ...mask of cameras feeding the pipeline */
+    u32                 cameras;
+
+    /* ...encoder bitrate (bit/s; 0 if not encoding) */
+    u32                 bitrate[CAMERAS_NUMBER];
+
+    /* ...frames passed to and dropped before encoders (benchmark interval) */
+    u32                 pushed[CAMERAS_NUMBER];
+    u32                 dropped[CAMERAS_NUMBER];
+
+}   stream_control_reply_t;
+
 
 /* ...Streaming ip */
 extern char                *__stream_ip;
@@ -65,10 +132,137 @@ extern char                *__stream_file;
 /* ...Streaming base port */
 extern int                 __stream_base_port;
 
+/* ...event recording pre-trigger and post-trigger intervals (seconds) */
+extern int                 __stream_event_pre;
+extern int                 __stream_event_post;
+
+/* ...maximal pre-trigger / post-trigger interval (bounds event rings allocation) */
+#define STREAM_EVENT_MAX                60
+
+/* ...pass exported camera buffers to streaming pipelines as DMA buffers */
+extern int                 __stream_dmabuf;
+
+/* ...maximal number of buffers queued for encoding per camera */
+extern int                 __stream_queue;
+
+/* ...H.264 encoder back-end (auto, omx, x264, openh264) */
+extern char               *__stream_encoder;
+
+/* ...uplink budget of all streamed cameras (kbit/s; 0 - fixed encoder bitrate) */
+extern int                 __stream_budget;
+
+/* ...UDP port receiving loss reports of stream receivers (0 - disabled) */
+extern int                 __stream_feedback_port;
+
+/* ...control socket path (NULL - message queue only) */
+extern char               *__stream_control_socket;
+
+/* ...recording output directory */
+extern char                *__record_dir;
+
+/* ...recording segment duration (seconds) and size (MB) limits; 0 - single file */
+extern int                 __record_segment_time;
+extern int                 __record_segment_size;
+
+/* ...number of segments kept per camera (0 - unlimited) */
+extern int                 __record_keep;
+
+/* ...preallocate segment files and flush them behind the writer */
+extern int                 __record_prealloc;
+
+/* ...benchmark report interval (in seconds) */
+extern int                 __benchmark_interval;
+
+/* ...cameras synchronization window (ms, 0 - take newest frames) */
+extern int                 __sync_window;
+
+/* ...maximal time to wait for a synchronized set (ms, 0 - use best available) */
+extern int                 __sync_wait;
+
+/* ...upload textures from a dedicated thread */
+extern int                 __async_upload;
+
+/* ...pass frames to renderer through per-camera mailboxes instead of queues */
+extern int                 __render_mailbox;
+
+/* ...rendering rate while paused or hidden (frames per second) */
+extern int                 __idle_fps;
+
 /*******************************************************************************
  * Types definitions
  ******************************************************************************/
 
+/* ...per-camera benchmark statistics */
+typedef struct app_bench
+{
+    /* ...number of buffers received from camera */
+    u32                 received;
+
+    /* ...number of buffers rendered */
+    u32                 rendered;
+
+    /* ...number of frames lost before reaching the application */
+    u32                 lost;
+
+    /* ...number of buffers superseded in rendering queue (updated atomically) */
+    u32                 skipped;
+
+    /* ...last received frame sequence number */
+    u64                 sequence;
+
+    /* ...sequence number validity flag */
+    int                 started;
+
+    /* ...dequeue-to-render latency accumulator and maximum (ns) */
+    u64                 latency_acc;
+    u64                 latency_max;
+
+}   app_bench_t;
+
+/* ...per-camera performance HUD counters (updated atomically, no locking) */
+typedef struct app_hud
+{
+    /* ...number of buffers received from camera */
+    u32                 received;
+
+    /* ...accumulated capture-to-queue latency (usec) */
+    u32                 decode_acc;
+
+    /* ...number of texture uploads and accumulated upload time (usec) */
+    u32                 uploads;
+    u32                 upload_acc;
+
+    /* ...rendering queue depth sampled at frame selection */
+    u32                 depth;
+
+}   app_hud_t;
+
+/* ...performance HUD refresh interval (usec) */
+#define APP_HUD_INTERVAL                1000000
+
+/* ...number of frame processing time samples kept for percentiles */
+#define APP_BENCH_FRAMES                1024
+
+/* ...number of cached CPU-upload textures per camera */
+#define APP_TEXTURE_CACHE_SIZE          8
+
+/* ...CPU-upload texture cache entry */
+typedef struct app_texture_cache
+{
+    /* ...buffer memory texture is bound to (NULL if content is uploaded on every frame) */
+    const void         *key;
+
+    /* ...cached texture */
+    texture_data_t     *tex;
+
+    /* ...image parameters texture has been created for */
+    int                 width, height, format;
+
+    /* ...last usage stamp (for replacement) */
+    u32                 used;
+
+}   app_texture_cache_t;
+
 /* ...surround-view application data */
 struct app_data
 {
@@ -93,11 +287,17 @@ struct app_data
     /* ...surround-view engine configuration data */
     sview_cfg_t        *sv_cfg;
 
+    /* ...engine configuration copy if textures format differs from camera format */
+    sview_cfg_t         engine_cfg;
+
     /* ...miscellaneous control flags */
     u32                 flags;
 
     /* ...pending output buffers (surround-view and frontal camera) */
     GQueue              render[CAMERAS_NUMBER + 1];
+
+    /* ...newest buffer pending for rendering (mailbox mode; exchanged atomically) */
+    GstBuffer          *mailbox[CAMERAS_NUMBER];
     /* ...Streamer pipelines */
     GstPipeline         *stream_pipeline;
 
@@ -107,6 +307,25 @@ struct app_data
     /* ...States of stream pipeline */
     int                 stream_state;
 
+    /* ...encoded frames ring of event recording pipeline */
+    event_recorder_t    *stream_event;
+
+    /* ...network rate controller of streaming pipeline */
+    stream_rate_t       *stream_rate;
+
+    /* ...mask of cameras feeding streaming pipeline */
+    u32                 stream_cameras;
+
+    /* ...camera buffers of current track are exported DMA buffers (live VIN track) */
+    int                 track_dmabuf;
+
+    /* ...streaming pipeline imports camera buffers as DMA buffers */
+    int                 stream_dmabuf;
+
+    /* ...frames passed to and dropped before encoders (benchmark interval) */
+    u32                 stream_pushed[CAMERAS_NUMBER];
+    u32                 stream_dropped[CAMERAS_NUMBER];
+
     /* ...Streaming ip */
     char                *stream_ip;
 
@@ -119,8 +338,11 @@ struct app_data
     /* ...Streaming frame count limit */
     int                 stream_frame_count;
 
-    /* ...stream control thread */
-    pthread_t           stream_control;
+    /* ...stream control channels are attached to the main loop */
+    int                 stream_control;
+
+    /* ...streaming pipeline lifecycle lock (not held by decoding/rendering threads) */
+    pthread_mutex_t     stream_lock;
 
     /* ...mask of available frames (for surround view) */
     u32                 frames;
@@ -149,6 +371,63 @@ struct app_data
 
     track_list_t       *track_list;
 
+    /* ...benchmark statistics */
+    app_bench_t         bench[CAMERAS_NUMBER];
+
+    /* ...benchmark reporting timestamp (usec) */
+    u32                 bench_ts;
+
+    /* ...frame processing time samples (usec) and number of frames rendered */
+    u32                 frame_time[APP_BENCH_FRAMES];
+    u32                 frame_count;
+
+    /* ...cameras synchronization waiting start timestamp (usec, 0 - not waiting) */
+    u32                 sync_ts;
+
+    /* ...number of frame sets rendered / rendered out of synchronization window */
+    u32                 sync_total;
+    u32                 sync_miss;
+
+    /* ...textures for buffers not carrying vsink metadata */
+    app_texture_cache_t tex_cache[CAMERAS_NUMBER][APP_TEXTURE_CACHE_SIZE];
+
+    /* ...texture cache usage counter */
+    u32                 tex_cache_seq;
+
+    /* ...asynchronous texture upload thread */
+    texture_upload_t   *upload;
+
+    /* ...on-screen text overlay */
+    overlay_t          *overlay;
+
+    /* ...performance HUD per-camera counters */
+    app_hud_t           hud[CAMERAS_NUMBER];
+
+    /* ...rendering stages timing accumulators (usec; accessed from rendering thread only) */
+    u32                 hud_frames, hud_engine, hud_gpu, hud_gpu_num, hud_swap;
+
+    /* ...performance HUD refresh timestamp (usec) */
+    u32                 hud_ts;
+
+    /* ...performance HUD text */
+    char                hud_text[512];
+
+    /* ...engine GPU time measurement (NULL if not supported) */
+    gpu_timer_t        *gpu_timer;
+
+    /* ...frame set kept on screen while paused (owned by rendering thread) */
+    GstBuffer          *held[CAMERAS_NUMBER];
+    GstMapInfo          held_maps[CAMERAS_NUMBER];
+    texture_data_t     *held_tex[CAMERAS_NUMBER];
+
+    /* ...last scene rendering timestamp in reduced-rate mode (usec) */
+    u32                 idle_ts;
+
+    /* ...scene view has changed while paused */
+    int                 scene_dirty;
+
+    /* ...window area covered by overlay in previous frame */
+    int                 damage[4];
 };
 
 /* ...double-linked list item */
@@ -291,6 +570,12 @@ extern void app_debug_enable(app_data_t *app, int enable);
 /* ...enable debugging output */
 extern int app_debug_enabled(app_data_t *app);
 
+/* ...enable performance HUD */
+extern void app_hud_enable(app_data_t *app, int enable);
+
+/* ...freeze displayed frames and render at reduced rate */
+extern void app_pause(app_data_t *app, int enable);
+
 /* ...close application */
 extern void app_exit(app_data_t *app);
 
@@ -317,7 +602,7 @@ extern int app_has_multiple_sources(app_data_t *app);
  * Streaming control
  ******************************************************************************/
 
-/* Create stream pipeline control thread */
+/* Attach stream pipeline control channels to the main loop */
 extern int stream_pipeline_control_start(app_data_t *app);
 
 /* Push buffer in stream pipeline */
@@ -351,4 +636,13 @@ extern int stream_pipeline_destroy(app_data_t *app);
 /* ...application has tracks file*/
 #define APP_FLAG_FILE                   (1 << 7)
 
+/* ...benchmark mode (latency/drop-rate reporting) */
+#define APP_FLAG_BENCHMARK              (1 << 8)
+
+/* ...performance HUD display */
+#define APP_FLAG_HUD                    (1 << 9)
+
+/* ...displayed frames are frozen */
+#define APP_FLAG_PAUSE                  (1 << 10)
+
 #endif  /* SV_SURROUNDVIEW_APP_H */
@@ -93,6 +93,17 @@ extern GstElement * camera_vin_create(const camera_callback_t *cb,
                                       int width,
                                       int height);
 
+/* ...VIN capturing threads configuration */
+extern int __vin_threads;
+extern int __vin_priority;
+extern int __vin_affinity[];
+extern int __vin_eventfd;
+
+/* ...VIN buffers configuration */
+extern int __vin_buffers;
+extern int __vin_format;
+extern int __vin_fps;
+
 extern camera_data_t * mjpeg_camera_create(int id,
                 GstBuffer * (*get_buffer)(void *, int),
                 void *cdata);
@@ -31,6 +31,9 @@
  ******************************************************************************/
 
 #include <fcntl.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/timerfd.h>
 
 #include "main.h"
@@ -201,3 +204,518 @@ int timer_source_is_active(timer_source_t *tsrc)
     return (tsrc->tag != NULL);
 }
 
+
+/*******************************************************************************
+ * File descriptor source support
+ ******************************************************************************/
+
+/* ...data-source handle */
+typedef struct fd_source
+{
+    /* ...generic source handle */
+    GSource             source;
+
+    /* ...file descriptor (owned by the source) */
+    int                 fd;
+
+    /* ...polling object tag */
+    gpointer            tag;
+
+}   fd_source_t;
+
+/* ...prepare handle */
+static gboolean fd_source_prepare(GSource *source, gint *timeout)
+{
+    /* ...we need to go to "poll" call anyway */
+    *timeout = -1;
+    return FALSE;
+}
+
+/* ...check function called after polling returns */
+static gboolean fd_source_check(GSource *source)
+{
+    fd_source_t    *fsrc = (fd_source_t *) source;
+
+    /* ...hang-up and errors are passed to a callback as well */
+    return (fsrc->tag && (g_source_query_unix_fd(source, fsrc->tag) & (G_IO_IN | G_IO_HUP | G_IO_ERR)));
+}
+
+/* ...dispatch function */
+static gboolean fd_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    fd_source_t    *fsrc = (fd_source_t *) source;
+
+    /* ...call dispatch function if still enabled */
+    return (fsrc->tag ? callback(user_data) : TRUE);
+}
+
+/* ...finalization function */
+static void fd_source_finalize(GSource *source)
+{
+    fd_source_t    *fsrc = (fd_source_t *) source;
+
+    close(fsrc->fd);
+
+    TRACE(DEBUG, _b("fd-source destroyed"));
+}
+
+/* ...source callbacks */
+static GSourceFuncs fd_source_funcs = {
+    .prepare = fd_source_prepare,
+    .check = fd_source_check,
+    .dispatch = fd_source_dispatch,
+    .finalize = fd_source_finalize,
+};
+
+/* ...create source of an open descriptor (ownership is taken) */
+fd_source_t * fd_source_create_fd(int fd, gint prio, GSourceFunc func,
+        gpointer user_data, GDestroyNotify notify, GMainContext *context)
+{
+    fd_source_t    *fsrc;
+    GSource        *source;
+
+    /* ...allocate source handle */
+    SV_CHK_ERR(source = g_source_new(&fd_source_funcs, sizeof(*fsrc)), (close(fd), NULL));
+
+    /* ...do not enable source until explicit resume command received */
+    (fsrc = (fd_source_t *)source)->fd = fd;
+    fsrc->tag = NULL;
+
+    /* ...set priority */
+    g_source_set_priority(source, prio);
+
+    /* ...set callback function */
+    g_source_set_callback(source, func, user_data, notify);
+
+    /* ...attach source to the requested context */
+    g_source_attach(source, context);
+
+    /* ...pass ownership to the loop */
+    g_source_unref(source);
+
+    return fsrc;
+}
+
+/* ...file source creation */
+fd_source_t * fd_source_create(const char *filename, gint prio, GSourceFunc func,
+        gpointer user_data, GDestroyNotify notify, GMainContext *context)
+{
+    int     fd;
+
+    /* ...open file in non-blocking mode */
+    SV_CHK_ERR((fd = open(filename, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) >= 0, NULL);
+
+    return fd_source_create_fd(fd, prio, func, user_data, notify, context);
+}
+
+/* ...retrive file descriptor */
+int fd_source_get_fd(fd_source_t *fsrc)
+{
+    return fsrc->fd;
+}
+
+/* ...suspend file source */
+void fd_source_suspend(fd_source_t *fsrc)
+{
+    GSource    *source = (GSource *)fsrc;
+
+    if (fsrc->tag)
+    {
+        g_source_remove_unix_fd(source, fsrc->tag);
+        fsrc->tag = NULL;
+
+        TRACE(DEBUG, _b("fd-source [%p] suspended"), fsrc);
+    }
+}
+
+/* ...resume file source */
+void fd_source_resume(fd_source_t *fsrc)
+{
+    GSource    *source = (GSource *)fsrc;
+
+    if (!fsrc->tag)
+    {
+        fsrc->tag = g_source_add_unix_fd(source, fsrc->fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
+
+        TRACE(DEBUG, _b("fd-source [%p] resumed"), fsrc);
+    }
+}
+
+/* ...check if data source is active */
+int fd_source_is_active(fd_source_t *fsrc)
+{
+    return (fsrc->tag != NULL);
+}
+
+/*******************************************************************************
+ * Capturing support
+ ******************************************************************************/
+
+/* ...samples per thread ring (power of two) */
+#define CAPTURE_RING_SIZE               4096
+
+/* ...maximal number of capture tags */
+#define CAPTURE_TAGS_MAX                256
+
+/* ...flushing period (msec) */
+#define CAPTURE_FLUSH_PERIOD            100
+
+/* ...stdio buffer of a capture file (bytes written per system call) */
+#define CAPTURE_FILE_BUFFER             (256 << 10)
+
+/* ...captured sample (four records per cache line) */
+typedef struct capture_record
+{
+    /* ...capture stream index */
+    u16                 tag;
+
+    /* ...sample size */
+    u16                 size;
+
+    /* ...sample data */
+    u8                  data[SV_CAPTURE_SAMPLE_MAX];
+
+}   __attribute__((aligned(16))) capture_record_t;
+
+/* ...per-thread single-producer/single-consumer ring */
+typedef struct capture_ring
+{
+    /* ...write index and lost samples counter (capturing thread) */
+    u32                 head __attribute__((aligned(64)));
+    u32                 dropped;
+
+    /* ...read index (flusher thread) */
+    u32                 tail __attribute__((aligned(64)));
+
+    /* ...lost samples already reported */
+    u32                 reported;
+
+    /* ...owning thread has exited; ring is released once drained */
+    int                 exited;
+
+    /* ...next ring in a global list */
+    struct capture_ring *next;
+
+    /* ...samples storage */
+    capture_record_t    rec[CAPTURE_RING_SIZE] __attribute__((aligned(64)));
+
+}   capture_ring_t;
+
+/* ...capturing thread ring */
+static __thread capture_ring_t  *__capture_ring;
+
+/* ...ring release on thread exit */
+static pthread_key_t            __capture_key;
+
+/* ...registered rings and tags (access lock; never held across file output) */
+static pthread_mutex_t          __capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static capture_ring_t          *__capture_rings;
+static sv_capture_tag_t        *__capture_tags[CAPTURE_TAGS_MAX];
+static int                      __capture_tags_num;
+
+/* ...rings draining lock (flusher thread and explicit flush) */
+static pthread_mutex_t          __capture_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ...output files (drain lock; samples of a tag that cannot be opened are discarded) */
+static FILE                    *__capture_file[CAPTURE_TAGS_MAX];
+static u8                       __capture_failed[CAPTURE_TAGS_MAX];
+
+/* ...flusher thread control */
+static pthread_once_t           __capture_once = PTHREAD_ONCE_INIT;
+static pthread_t                __capture_thread;
+static pthread_cond_t           __capture_wait;
+static int                      __capture_exit;
+
+/* ...write out samples of all rings (flusher thread or final flush) */
+static void capture_drain(void)
+{
+    capture_ring_t    **prev, *ring, *rings;
+    capture_record_t   *r;
+    FILE               *f;
+    u32                 head, tail;
+    int                 i, num, dead = 0;
+
+    pthread_mutex_lock(&__capture_drain_lock);
+
+    /* ...new rings are prepended; list tail is only modified by a drainer */
+    pthread_mutex_lock(&__capture_lock);
+    rings = __capture_rings;
+    num = __capture_tags_num;
+    pthread_mutex_unlock(&__capture_lock);
+
+    for (ring = rings; ring != NULL; ring = ring->next)
+    {
+        /* ...samples become visible along with write index (tags are published before) */
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        for (tail = ring->tail; tail != head; tail++)
+        {
+            r = &ring->rec[tail & (CAPTURE_RING_SIZE - 1)];
+
+            /* ...file is opened on first sample (full buffer is one write) */
+            if ((f = __capture_file[r->tag]) == NULL)
+            {
+                if (__capture_failed[r->tag])
+                {
+                    continue;
+                }
+
+                if ((f = fopen(__capture_tags[r->tag]->name, "wb")) == NULL)
+                {
+                    TRACE(ERROR, _x("failed to open tag file %s: %m"), __capture_tags[r->tag]->name);
+                    __capture_failed[r->tag] = 1;
+                    continue;
+                }
+
+                setvbuf(f, NULL, _IOFBF, CAPTURE_FILE_BUFFER);
+                __capture_file[r->tag] = f;
+            }
+
+            fwrite(r->data, r->size, 1, f);
+            num = (r->tag > num ? r->tag : num);
+        }
+
+        /* ...release ring slots to the capturing thread */
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        if (ring->reported != __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED))
+        {
+            ring->reported = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+            TRACE(WARNING, _b("capture ring overflow: %u samples lost"), ring->reported);
+        }
+
+        /* ...ring of terminated thread is not written anymore */
+        dead += (__atomic_load_n(&ring->exited, __ATOMIC_ACQUIRE) && tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+    }
+
+    for (i = 1; i <= num; i++)
+    {
+        (__capture_file[i] ? fflush(__capture_file[i]) : 0);
+    }
+
+    /* ...drained rings of terminated threads are unlinked (exited flag is never reset) */
+    if (dead)
+    {
+        pthread_mutex_lock(&__capture_lock);
+
+        for (prev = &__capture_rings; (ring = *prev) != NULL; )
+        {
+            if (__atomic_load_n(&ring->exited, __ATOMIC_ACQUIRE) && ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+            {
+                *prev = ring->next;
+                free(ring);
+            }
+            else
+            {
+                prev = &ring->next;
+            }
+        }
+
+        pthread_mutex_unlock(&__capture_lock);
+    }
+
+    pthread_mutex_unlock(&__capture_drain_lock);
+}
+
+/* ...flusher thread */
+static void * capture_thread(void *arg)
+{
+    struct timespec     ts;
+
+    pthread_mutex_lock(&__capture_lock);
+
+    while (!__capture_exit)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_nsec += CAPTURE_FLUSH_PERIOD * 1000000;
+        (ts.tv_nsec >= 1000000000 ? ts.tv_sec++, ts.tv_nsec -= 1000000000 : 0);
+        pthread_cond_timedwait(&__capture_wait, &__capture_lock, &ts);
+
+        pthread_mutex_unlock(&__capture_lock);
+        capture_drain();
+        pthread_mutex_lock(&__capture_lock);
+    }
+
+    pthread_mutex_unlock(&__capture_lock);
+
+    return NULL;
+}
+
+/* ...stop flusher and write out remaining samples at exit */
+static void capture_shutdown(void)
+{
+    pthread_mutex_lock(&__capture_lock);
+    __capture_exit = 1;
+    pthread_cond_signal(&__capture_wait);
+    pthread_mutex_unlock(&__capture_lock);
+
+    pthread_join(__capture_thread, NULL);
+
+    sv_capture_flush();
+}
+
+/* ...capturing thread exit */
+static void capture_ring_release(void *arg)
+{
+    capture_ring_t     *ring = arg;
+
+    __atomic_store_n(&ring->exited, 1, __ATOMIC_RELEASE);
+}
+
+/* ...start flusher thread */
+static void capture_init(void)
+{
+    pthread_condattr_t  attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&__capture_wait, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_key_create(&__capture_key, capture_ring_release);
+
+    if (pthread_create(&__capture_thread, NULL, capture_thread, NULL) != 0)
+    {
+        TRACE(ERROR, _x("failed to create capture flusher thread"));
+        return;
+    }
+
+    atexit(capture_shutdown);
+}
+
+/* ...register a capture stream */
+static int capture_tag_register(sv_capture_tag_t *tag)
+{
+    int     id;
+
+    pthread_once(&__capture_once, capture_init);
+
+    pthread_mutex_lock(&__capture_lock);
+
+    /* ...tag could have been registered by another thread */
+    if ((id = tag->id) == 0 && __capture_tags_num < CAPTURE_TAGS_MAX - 1)
+    {
+        __capture_tags[id = ++__capture_tags_num] = tag;
+        __atomic_store_n(&tag->id, id, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&__capture_lock);
+
+    return id;
+}
+
+/* ...allocate ring of a capturing thread */
+static capture_ring_t * capture_ring_create(void)
+{
+    capture_ring_t     *ring;
+
+    if ((ring = aligned_alloc(64, sizeof(*ring))) == NULL)
+    {
+        return NULL;
+    }
+
+    memset(ring, 0, offsetof(capture_ring_t, rec));
+    pthread_setspecific(__capture_key, ring);
+
+    pthread_mutex_lock(&__capture_lock);
+    ring->next = __capture_rings, __capture_rings = ring;
+    pthread_mutex_unlock(&__capture_lock);
+
+    return (__capture_ring = ring);
+}
+
+/* ...put sample into calling thread ring (no locks and system calls) */
+void sv_capture_write(sv_capture_tag_t *tag, const void *data, uint32_t size)
+{
+    capture_ring_t     *ring = __capture_ring;
+    capture_record_t   *r;
+    int                 id;
+    u32                 head;
+
+    if ((id = __atomic_load_n(&tag->id, __ATOMIC_ACQUIRE)) == 0 && (id = capture_tag_register(tag)) == 0)
+    {
+        return;
+    }
+
+    if (ring == NULL && (ring = capture_ring_create()) == NULL)
+    {
+        return;
+    }
+
+    head = ring->head;
+
+    /* ...flusher is late; newest sample is lost rather than capturing thread delayed */
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= CAPTURE_RING_SIZE)
+    {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    r = &ring->rec[head & (CAPTURE_RING_SIZE - 1)];
+    r->tag = id;
+    r->size = size;
+    memcpy(r->data, data, size);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    /* ...kick flusher when half of a ring is filled (one wakeup per many samples) */
+    if (((head + 1) & (CAPTURE_RING_SIZE / 2 - 1)) == 0)
+    {
+        pthread_cond_signal(&__capture_wait);
+    }
+}
+
+/* ...write out all captured samples */
+void sv_capture_flush(void)
+{
+    capture_drain();
+}
+
+/*******************************************************************************
+ * Performance monitor counters calibration
+ ******************************************************************************/
+
+/* ...calibration interval (msec) */
+#define PM_CALIBRATION_PERIOD           10
+
+/* ...nanoseconds per raw counter tick */
+static double                   __pm_scale = 1.0;
+
+/* ...calibration control */
+static pthread_once_t           __pm_once = PTHREAD_ONCE_INIT;
+
+/* ...measure raw counter rate against monotonic clock */
+static void pm_calibrate(void)
+{
+#if defined(__aarch64__)
+    uint64_t            freq;
+
+    /* ...generic timer reports its frequency */
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (freq));
+
+    __pm_scale = (freq ? 1e+09 / freq : 1.0);
+#elif defined(__x86_64__) || defined(__i386__)
+    struct timespec     ts = { 0, PM_CALIBRATION_PERIOD * 1000000 };
+    uint64_t            t0, t1, c0, c1;
+
+    t0 = get_time_nsec(), c0 = get_cpu_counter();
+    nanosleep(&ts, NULL);
+    t1 = get_time_nsec(), c1 = get_cpu_counter();
+
+    __pm_scale = (c1 > c0 ? (double)(t1 - t0) / (c1 - c0) : 1.0);
+#endif
+
+    TRACE(DEBUG, _b("performance counter: %.4f nsec per tick"), __pm_scale);
+}
+
+/* ...calibrate counters at application initialization */
+void sv_pm_init(void)
+{
+    pthread_once(&__pm_once, pm_calibrate);
+}
+
+/* ...convert raw CPU counter delta into nanoseconds (scale is set by sv_pm_init) */
+uint64_t sv_pm_cycles_to_nsec(uint64_t cycles)
+{
+    return (uint64_t)(cycles * __pm_scale);
+}
@@ -69,6 +69,13 @@ extern fd_source_t * fd_source_create(const char *filename,
         GDestroyNotify notify,
         GMainContext *context);
 
+extern fd_source_t * fd_source_create_fd(int fd,
+        gint prio,
+        GSourceFunc func,
+        gpointer user_data,
+        GDestroyNotify notify,
+        GMainContext *context);
+
 extern int fd_source_get_fd(fd_source_t *fsrc);
 extern void fd_source_suspend(fd_source_t *fsrc);
 extern void fd_source_resume(fd_source_t *fsrc);
@@ -32,6 +32,7 @@
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/poll.h>
 #include <sys/epoll.h>
 
@@ -42,11 +43,19 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#if defined (TEXTURE_UPLOAD_PBO)
+#include <GLES3/gl3.h>
+#endif
+
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
 #include <libdrm/drm_fourcc.h>
 
+#if defined (PRESENTATION_TIME_ENABLED)
+#include "presentation-time-client-protocol.h"
+#endif
+
 #include <cairo-gl.h>
 #include <math.h>
 
@@ -159,6 +168,17 @@ struct display_data
     /* ...shared memory interface handle (not used?) */
     struct wl_shm *shm;
 
+    /* ...frame callbacks and presentation feedback queue (dispatched by display thread) */
+    struct wl_event_queue *frame_queue;
+
+#if defined (PRESENTATION_TIME_ENABLED)
+    /* ...presentation timing interface (NULL if not supported) and its wrapper bound to frame queue */
+    struct wp_presentation *presentation, *presentation_wrapper;
+
+    /* ...presentation timestamps clock */
+    clockid_t presentation_clock;
+#endif
+
     /* ...input/output device handles */
     struct wl_list outputs, inputs;
 
@@ -182,6 +202,22 @@ struct display_data
 
     /* ...display lock (need that really? - tbd) */
     pthread_mutex_t lock;
+
+    /* ...imported dmabuf textures cache */
+    struct texture_dma_cache *dma_cache;
+
+    /* ...dmabuf textures cache lock */
+    pthread_mutex_t dma_lock;
+
+    /* ...dmabuf textures cache statistics */
+    u32 dma_hits, dma_misses;
+
+    /* ...YUV to RGB conversion program and its bindings */
+    GLuint yuv_program;
+    GLint yuv_a_pos, yuv_u_luma, yuv_u_chroma, yuv_u_mode, yuv_u_width;
+
+    /* ...source line length can be set for uploads (GL_EXT_unpack_subimage) */
+    int yuv_unpack_subimage;
 };
 
 /* ...output window data */
@@ -207,6 +243,30 @@ struct window_data
 
     /* ...EGL surface */
     EGLSurface egl;
+
+    /* ...surface wrapper creating frame callbacks in frame queue (rendering thread) */
+    struct wl_surface *surface_wrapper;
+
+    /* ...pending frame callback (presentation pacing) */
+    struct wl_callback *frame_cb;
+
+#if defined (PRESENTATION_TIME_ENABLED)
+    /* ...pending presentation feedback and submission time of its frame (usec) */
+    struct wp_presentation_feedback *feedback;
+    u32 feedback_ts;
+#endif
+
+    /* ...last presentation time and estimated refresh period (usec) */
+    u32 present_ts, present_period;
+
+    /* ...rendering start / buffer submission timestamps and estimated rendering time (usec) */
+    u32 render_ts, swap_ts, render_time;
+
+    /* ...submission-to-presentation (or frame callback) latency statistics (usec) */
+    u32 present_acc, present_max, present_num;
+
+    /* ...pending frame callback request timestamp (usec) */
+    u32 frame_req_ts;
 };
 
 /*******************************************************************************
@@ -216,6 +276,11 @@ struct window_data
 /* ...this should be singleton for now - tbd */
 static display_data_t __display;
 
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+/* ...shader YUV conversion program creation */
+static int texture_yuv_init(display_data_t *display);
+#endif
+
 /*******************************************************************************
  * EGL functions binding (make them global; create EGL adaptation layer - tbd)
  ******************************************************************************/
@@ -235,6 +300,15 @@ PFNGLISVERTEXARRAYOESPROC glIsVertexArrayOES;
 PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
 PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
 PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+
+/* ...GPU timer queries (GL_EXT_disjoint_timer_query) */
+static PFNGLGENQUERIESEXTPROC glGenQueriesEXT;
+static PFNGLDELETEQUERIESEXTPROC glDeleteQueriesEXT;
+static PFNGLBEGINQUERYEXTPROC glBeginQueryEXT;
+static PFNGLENDQUERYEXTPROC glEndQueryEXT;
+static PFNGLGETQUERYOBJECTIVEXTPROC glGetQueryObjectivEXT;
+static PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
 
 
 /*******************************************************************************
@@ -249,6 +323,24 @@ PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
 
 #define MAX_ATTRIBUTES_COUNT 30
 
+/* ...Mesa surfaceless platform (headless rendering) */
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA   0x31DD
+#endif
+
+/* ...default offscreen surface dimensions in headless mode */
+#define HEADLESS_WIDTH                  1920
+#define HEADLESS_HEIGHT                 1080
+
+/* ...initial refresh period assumption for frame pacing (usec) */
+#define PACING_DEFAULT_PERIOD           16667
+
+/* ...safety margin for rendering start before predicted vblank (usec) */
+#define PACING_MARGIN                   2000
+
+/* ...frame callback starvation interval treated as hidden window (usec) */
+#define VISIBILITY_TIMEOUT              500000
+
 /*******************************************************************************
  * Internal helpers
  ******************************************************************************/
@@ -364,7 +456,8 @@ static void * dispatch_thread(void *arg)
             }
 
             /* ...process pending display events (if any) */
-            if (wl_display_dispatch_pending(display->display) < 0)
+            if (wl_display_dispatch_pending(display->display) < 0 ||
+                wl_display_dispatch_queue_pending(display->display, display->frame_queue) < 0)
             {
                 TRACE(ERROR, _x("failed to dispatch display events: %m"));
                 goto error;
@@ -1237,6 +1330,27 @@ error:
 }
 #endif
 
+#if defined (PRESENTATION_TIME_ENABLED)
+/*******************************************************************************
+ * Presentation timing interface
+ ******************************************************************************/
+
+/* ...presentation timestamps clock notification */
+static void presentation_handle_clock_id(void *data, struct wp_presentation *presentation, uint32_t clk_id)
+{
+    display_data_t *display = data;
+
+    display->presentation_clock = clk_id;
+
+    TRACE(INIT, _b("display[%p]: presentation clock: %u"), display, clk_id);
+}
+
+static const struct wp_presentation_listener presentation_listener =
+{
+    presentation_handle_clock_id,
+};
+#endif
+
 /*******************************************************************************
  * Registry listener callbacks
  ******************************************************************************/
@@ -1267,6 +1381,13 @@ static void global_registry_handler(void *data, struct wl_registry *registry, ui
     {
         display_add_input(display, registry, id, version);
     }
+#if defined (PRESENTATION_TIME_ENABLED)
+    else if (strcmp(interface, wp_presentation_interface.name) == 0)
+    {
+        display->presentation = wl_registry_bind(registry, id, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(display->presentation, &presentation_listener, display);
+    }
+#endif
 }
 
 /* ...interface removal notification callback */
@@ -1315,6 +1436,210 @@ static const struct wl_shell_surface_listener shell_surface_listener =
     handle_popup_done
 };
 
+/*******************************************************************************
+ * Frame pacing
+ ******************************************************************************/
+
+/* ...presentation feedback is available */
+static inline int window_presentation(window_data_t *window)
+{
+#if defined (PRESENTATION_TIME_ENABLED)
+    return (window->base.display->presentation != NULL);
+#else
+    return 0;
+#endif
+}
+
+/* ...frame callback notification; a hint to draw next frame (display thread context) */
+static void frame_handle_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+    window_data_t *window = data;
+    u32 ts = get_time_usec();
+    u32 delta, latency = 0;
+
+    pthread_mutex_lock(&window->base.lock);
+
+    window->frame_cb = NULL;
+
+    /* ...timings are taken from presentation feedback if compositor provides it */
+    if (window_presentation(window))
+    {
+        pthread_mutex_unlock(&window->base.lock);
+        wl_callback_destroy(callback);
+        return;
+    }
+
+    /* ...refine refresh period estimation; skip intervals with missed vblanks */
+    if (window->present_ts != 0)
+    {
+        delta = ts - window->present_ts;
+
+        if (delta > window->present_period / 2 && delta < window->present_period * 3 / 2)
+        {
+            window->present_period = (window->present_period * 7 + delta) / 8;
+        }
+    }
+
+    /* ...account submission-to-frame-callback latency (nothing submitted yet - nothing to account) */
+    if (window->swap_ts != 0)
+    {
+        latency = ts - window->swap_ts;
+        window->present_acc += latency;
+        (window->present_max < latency ? window->present_max = latency : 0);
+        window->present_num++;
+    }
+
+    window->present_ts = ts;
+
+    pthread_mutex_unlock(&window->base.lock);
+
+    wl_callback_destroy(callback);
+
+    TRACE(DEBUG, _b("window[%p] frame callback: latency=%u, period=%u"), window, latency, window->present_period);
+}
+
+static const struct wl_callback_listener frame_listener =
+{
+    frame_handle_done,
+};
+
+#if defined (PRESENTATION_TIME_ENABLED)
+/* ...translate presentation timestamp into monotonic clock (usec) */
+static u32 presentation_time_usec(display_data_t *display, u64 sec, u32 nsec)
+{
+    struct timespec ts;
+    u64 t = sec * 1000000 + nsec / 1000;
+
+    if (display->presentation_clock == CLOCK_MONOTONIC)
+    {
+        return (u32)t;
+    }
+
+    /* ...shift current monotonic time back by the age of a frame in compositor clock */
+    clock_gettime(display->presentation_clock, &ts);
+
+    return get_time_usec() - (u32)((u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - t);
+}
+
+/* ...feedback is related to an output (not used) */
+static void feedback_handle_sync_output(void *data, struct wp_presentation_feedback *feedback, struct wl_output *output)
+{
+}
+
+/* ...frame has been shown (display thread context) */
+static void feedback_handle_presented(void *data, struct wp_presentation_feedback *feedback,
+                                      uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+                                      uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    window_data_t *window = data;
+    u32 ts = presentation_time_usec(window->base.display, ((u64)tv_sec_hi << 32) | tv_sec_lo, tv_nsec);
+    u32 latency;
+
+    pthread_mutex_lock(&window->base.lock);
+
+    /* ...account submission-to-presentation latency */
+    latency = ts - window->feedback_ts;
+    window->present_acc += latency;
+    (window->present_max < latency ? window->present_max = latency : 0);
+    window->present_num++;
+
+    /* ...refresh period is reported by compositor (zero if unknown) */
+    (refresh ? window->present_period = refresh / 1000 : 0);
+    window->present_ts = ts;
+    window->feedback = NULL;
+
+    pthread_mutex_unlock(&window->base.lock);
+
+    wp_presentation_feedback_destroy(feedback);
+
+    TRACE(DEBUG, _b("window[%p] frame presented: latency=%u, period=%u"), window, latency, window->present_period);
+}
+
+/* ...frame has never been shown (display thread context) */
+static void feedback_handle_discarded(void *data, struct wp_presentation_feedback *feedback)
+{
+    window_data_t *window = data;
+
+    pthread_mutex_lock(&window->base.lock);
+    window->feedback = NULL;
+    pthread_mutex_unlock(&window->base.lock);
+
+    wp_presentation_feedback_destroy(feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener =
+{
+    feedback_handle_sync_output,
+    feedback_handle_presented,
+    feedback_handle_discarded,
+};
+#endif
+
+/* ...wait until the latest moment allowing to render for the next vblank */
+static void window_pacing_wait(window_data_t *window)
+{
+    u32 now = get_time_usec();
+    u32 period, next;
+    s32 delay;
+
+    pthread_mutex_lock(&window->base.lock);
+
+    /* ...no presentation feedback yet */
+    if (window->present_ts == 0)
+    {
+        pthread_mutex_unlock(&window->base.lock);
+        return;
+    }
+
+    /* ...predict first vblank we still can make */
+    period = window->present_period;
+    next = window->present_ts + ((now + window->render_time - window->present_ts) / period + 1) * period;
+    delay = (s32)(next - window->render_time - PACING_MARGIN - now);
+
+    pthread_mutex_unlock(&window->base.lock);
+
+    TRACE(DEBUG, _b("window[%p] pacing: next vblank in %d usec, delay=%d"), window, (s32)(next - now), delay);
+
+    (delay > 0 ? usleep(delay) : 0);
+}
+
+/* ...check if compositor keeps presenting the window */
+int window_is_visible(window_data_t *window)
+{
+    int visible;
+
+    /* ...offscreen surface has no compositor feedback */
+    if (window->surface == NULL)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&window->base.lock);
+    visible = (window->frame_cb == NULL || (u32)(get_time_usec() - window->frame_req_ts) < VISIBILITY_TIMEOUT);
+    pthread_mutex_unlock(&window->base.lock);
+
+    return visible;
+}
+
+/* ...retrieve and reset presentation statistics */
+int window_present_stats(window_data_t *window, uint32_t *period, uint32_t *avg, uint32_t *max, int *presented)
+{
+    int n;
+
+    pthread_mutex_lock(&window->base.lock);
+
+    *presented = window_presentation(window);
+    n = window->present_num;
+    *period = window->present_period;
+    *avg = (n ? window->present_acc / n : 0);
+    *max = window->present_max;
+    window->present_acc = window->present_max = window->present_num = 0;
+
+    pthread_mutex_unlock(&window->base.lock);
+
+    return n;
+}
+
 /*******************************************************************************
  * EGL helpers
  ******************************************************************************/
@@ -1352,8 +1677,23 @@ static int init_egl(display_data_t *display)
     EGLDisplay dpy;
     const char *extensions;
 
-    /* ...get Wayland EGL display */
-    CHK_ERR(display->egl.dpy = dpy = eglGetDisplay((NativeDisplayType)display->display), -ENOENT);
+    if (__display_headless)
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+
+        /* ...offscreen rendering into pbuffer surfaces */
+        config_attribs[1] = EGL_PBUFFER_BIT;
+
+        /* ...get surfaceless platform display (no compositor / GPU device needed) */
+        get_platform_display = (void *) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        CHK_ERR(get_platform_display, -ENOSYS);
+        CHK_ERR(display->egl.dpy = dpy = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL), -ENOENT);
+    }
+    else
+    {
+        /* ...get Wayland EGL display */
+        CHK_ERR(display->egl.dpy = dpy = eglGetDisplay((NativeDisplayType)display->display), -ENOENT);
+    }
 
     /* ...initialize EGL module? */
     if (!eglInitialize(dpy, &major, &minor))
@@ -1444,6 +1784,14 @@ found:
     eglCreateSyncKHR = (void *) eglGetProcAddress("eglCreateSyncKHR");
     eglDestroySyncKHR = (void *) eglGetProcAddress("eglDestroySyncKHR");
     eglClientWaitSyncKHR = (void *) eglGetProcAddress("eglClientWaitSyncKHR");
+    eglWaitSyncKHR = (void *) eglGetProcAddress("eglWaitSyncKHR");
+
+    glGenQueriesEXT = (void *) eglGetProcAddress("glGenQueriesEXT");
+    glDeleteQueriesEXT = (void *) eglGetProcAddress("glDeleteQueriesEXT");
+    glBeginQueryEXT = (void *) eglGetProcAddress("glBeginQueryEXT");
+    glEndQueryEXT = (void *) eglGetProcAddress("glEndQueryEXT");
+    glGetQueryObjectivEXT = (void *) eglGetProcAddress("glGetQueryObjectivEXT");
+    glGetQueryObjectui64vEXT = (void *) eglGetProcAddress("glGetQueryObjectui64vEXT");
 
     /* ...make sure we have eglImageKHR extension */
     BUG(!(eglCreateImageKHR && eglDestroyImageKHR), _x("breakpoint"));
@@ -1454,6 +1802,22 @@ found:
         TRACE(INIT, _b("EGL extensions: %s"), extensions);
     }
 
+    /* ...damage-aware swap is optional (KHR and EXT variants share a signature) */
+    if (extensions && strstr(extensions, "EGL_KHR_swap_buffers_with_damage"))
+    {
+        eglSwapBuffersWithDamageEXT = (void *) eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    }
+    else if (!extensions || !strstr(extensions, "EGL_EXT_swap_buffers_with_damage"))
+    {
+        eglSwapBuffersWithDamageEXT = NULL;
+    }
+
+    /* ...server-side fence wait is optional; renderer falls back to bounded client wait */
+    if (!extensions || !strstr(extensions, "EGL_KHR_wait_sync"))
+    {
+        eglWaitSyncKHR = NULL;
+    }
+
     /* ...create display (shared?) EGL context */
     if ((display->egl.ctx = eglCreateContext(dpy, display->egl.conf, EGL_NO_CONTEXT, __egl_context_attribs)) == NULL)
     {
@@ -1567,10 +1931,14 @@ static void * window_thread(void *arg)
             /* ...release window access lock */
             pthread_mutex_unlock(&window->base.lock);
 
+            /* ...postpone rendering to pick up the freshest frames */
+            (window->surface && __display_pacing ? window_pacing_wait(window) : 0);
+
             /* ...re-acquire window GL context */
             eglMakeCurrent(display->egl.dpy, window->egl, window->egl, window->user_egl_ctx);
 
             /* ...invoke user-supplied hook */
+            window->render_ts = get_time_usec();
             window->base.info->redraw(display, window->base.cdata);
         }
         else
@@ -1749,22 +2117,28 @@ window_data_t * window_create(display_data_t *display, window_info_t *info, widg
     pthread_attr_t attr;
     int r;
 
-    /* ...make sure we have a valid output device */
-    if ((output = display_get_output(display, info->output)) == NULL) {
+    /* ...make sure we have a valid output device (there are none in headless mode) */
+    if (__display_headless) {
+        output = NULL;
+    } else if ((output = display_get_output(display, info->output)) == NULL) {
         TRACE(ERROR, _b("invalid output device number: %u"), info->output);
         errno = EINVAL;
         return NULL;
     }
 
     /* ...allocate a window data */
-    if ((window = malloc(sizeof (*window))) == NULL) {
+    if ((window = calloc(1, sizeof (*window))) == NULL) {
         TRACE(ERROR, _x("failed to allocate memory"));
         errno = ENOMEM;
         return NULL;
     }
 
     /* ...if width/height are not specified, use output device dimensions */
-    (!width ? width = output->width : 0), (!height ? height = output->height : 0);
+    if (output) {
+        (!width ? width = output->width : 0), (!height ? height = output->height : 0);
+    } else {
+        (!width ? width = HEADLESS_WIDTH : 0), (!height ? height = HEADLESS_HEIGHT : 0);
+    }
 
     /* ...initialize window data access lock */
     pthread_mutex_init(&window->base.lock, NULL);
@@ -1784,6 +2158,25 @@ window_data_t * window_create(display_data_t *display, window_info_t *info, widg
     /* ...reset frame-rate calculator */
     window_frame_rate_reset(window);
 
+    /* ...assume default refresh rate until presentation feedback arrives */
+    window->present_period = PACING_DEFAULT_PERIOD;
+
+    if (__display_headless)
+    {
+        EGLint attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+
+        /* ...render into offscreen surface */
+        window->surface = NULL, window->shell = NULL, window->native = NULL;
+        window->egl = eglCreatePbufferSurface(display->egl.dpy, display->egl.conf, attribs);
+        if (window->egl == EGL_NO_SURFACE)
+        {
+            TRACE(ERROR, _x("failed to create pbuffer surface: %X"), eglGetError());
+            goto error;
+        }
+
+        goto surface_created;
+    }
+
     /* ...get wayland surface (subsurface maybe?) */
     window->surface = wl_compositor_create_surface(display->compositor);
 
@@ -1803,10 +2196,15 @@ window_data_t * window_create(display_data_t *display, window_info_t *info, widg
     /* ...set private data poitner */
     wl_surface_set_user_data(window->surface, window);
 
+    /* ...frame callbacks are requested from rendering thread */
+    window->surface_wrapper = wl_proxy_create_wrapper(window->surface);
+    wl_proxy_set_queue((struct wl_proxy *)window->surface_wrapper, display->frame_queue);
+
     /* ...create native window */
     window->native = wl_egl_window_create(window->surface, width, height);
     window->egl = eglCreateWindowSurface(display->egl.dpy, display->egl.conf, (EGLNativeWindowType)window->native, NULL);
 
+surface_created:
     /* ...create window user EGL context (share textures with everything else?)*/
     window->user_egl_ctx = eglCreateContext(display->egl.dpy, display->egl.conf, display->egl.ctx, __egl_context_attribs);
 
@@ -1830,6 +2228,9 @@ window_data_t * window_create(display_data_t *display, window_info_t *info, widg
     /* ...set window EGL context */
     eglMakeCurrent(display->egl.dpy, window->egl, window->egl, window->user_egl_ctx);
 
+    /* ...rendering is paced by frame callbacks; do not block in swap */
+    (window->surface && __display_pacing ? eglSwapInterval(display->egl.dpy, 0) : 0);
+
     /* ...initialize root widget data */
     if (__widget_init(&window->base.widget, window, width, height, info2, cdata) < 0)
     {
@@ -1935,6 +2336,24 @@ void window_destroy(window_data_t *window)
     /* ...destroy EGL surface */
     eglDestroySurface(display->egl.dpy, window->egl);
 
+    /* ...offscreen surface has no native counterpart */
+    if (__display_headless)
+    {
+        goto out;
+    }
+
+    /* ...drop pending frame callback and presentation feedback */
+    pthread_mutex_lock(&window->base.lock);
+    (window->frame_cb ? wl_callback_destroy(window->frame_cb) : (void)0);
+    window->frame_cb = NULL;
+#if defined (PRESENTATION_TIME_ENABLED)
+    (window->feedback ? wp_presentation_feedback_destroy(window->feedback) : (void)0);
+    window->feedback = NULL;
+#endif
+    pthread_mutex_unlock(&window->base.lock);
+
+    wl_proxy_wrapper_destroy(window->surface_wrapper);
+
     /* ...destroy native window */
     wl_egl_window_destroy(window->native);
 
@@ -1959,6 +2378,7 @@ void window_destroy(window_data_t *window)
         pthread_mutex_lock(&wait_lock);
     }
 
+out:
     /* ...destroy window lock */
     pthread_mutex_destroy(&window->base.lock);
 
@@ -2012,19 +2432,74 @@ void window_put_cairo(window_data_t *window, cairo_t *cr)
 
 /* ...submit window to a renderer */
 void window_draw(window_data_t *window)
+{
+    window_draw_damage(window, NULL, 0);
+}
+
+/* ...submit window content; compositor is told only listed regions have changed */
+void window_draw_damage(window_data_t *window, const int *rects, int n)
 {
     u32 t0, t1;
 
     t0 = get_cpu_cycles();
 
+    /* ...request frame callback and presentation feedback before surface gets committed */
+    if (window->surface)
+    {
+        pthread_mutex_lock(&window->base.lock);
+
+        /* ...objects are created through wrappers in frame queue (display thread dispatches it) */
+        if (window->frame_cb == NULL)
+        {
+            window->frame_cb = wl_surface_frame(window->surface_wrapper);
+            wl_callback_add_listener(window->frame_cb, &frame_listener, window);
+            window->frame_req_ts = get_time_usec();
+        }
+
+#if defined (PRESENTATION_TIME_ENABLED)
+        /* ...one frame in flight is sampled; latency includes buffer submission */
+        if (window_presentation(window) && window->feedback == NULL)
+        {
+            window->feedback = wp_presentation_feedback(window->base.display->presentation_wrapper, window->surface);
+            wp_presentation_feedback_add_listener(window->feedback, &feedback_listener, window);
+            window->feedback_ts = get_time_usec();
+        }
+#endif
+
+        pthread_mutex_unlock(&window->base.lock);
+    }
+
     /* ...swap buffers (finalize any pending 2D-drawing) */
-    cairo_gl_surface_swapbuffers(window->base.widget.cs);
+    if (n > 0 && eglSwapBuffersWithDamageEXT && window->surface)
+    {
+        cairo_surface_flush(window->base.widget.cs);
+        eglSwapBuffersWithDamageEXT(window->base.display->egl.dpy, window->egl, (EGLint *)rects, n);
+    }
+    else
+    {
+        cairo_gl_surface_swapbuffers(window->base.widget.cs);
+    }
+
+    /* ...update submission time (latency statistics) and rendering time estimation (pacing) */
+    if (window->surface)
+    {
+        u32 ts = get_time_usec();
+
+        pthread_mutex_lock(&window->base.lock);
+        window->swap_ts = ts;
+        (__display_pacing ? window->render_time = (window->render_time * 7 + (ts - window->render_ts)) / 8 : 0);
+        window->render_ts = ts;
+        pthread_mutex_unlock(&window->base.lock);
+    }
 
     /* ...make sure everything is correct */
     BUG(cairo_surface_status(window->base.widget.cs) != CAIRO_STATUS_SUCCESS,
         _x("bad status: %s"),
         cairo_status_to_string(cairo_surface_status(window->base.widget.cs)));
 
+    /* ...offscreen swap does not throttle; account rendering completion */
+    (__display_headless ? glFinish() : (void)0);
+
     t1 = get_cpu_cycles();
 
     TRACE(DEBUG, _b("swap[%p]: %u (error=%X)"), window, t1 - t0, eglGetError());
@@ -2058,8 +2533,12 @@ display_data_t * display_create(void)
     /* ...reset display data */
     memset(display, 0, sizeof (*display));
 
-    /* ...connect to Wayland display */
-    if ((display->display = wl_display_connect(NULL)) == NULL)
+    /* ...connect to Wayland display unless rendering offscreen */
+    if (__display_headless)
+    {
+        TRACE(INIT, _b("headless mode: no Wayland connection"));
+    }
+    else if ((display->display = wl_display_connect(NULL)) == NULL)
     {
         TRACE(ERROR, _x("failed to connect to Wayland: %m"));
         errno = EBADFD;
@@ -2075,6 +2554,9 @@ display_data_t * display_create(void)
     {
         /* ...set global registry listener */
         wl_registry_add_listener(display->registry, &registry_listener, display);
+
+        /* ...frame callbacks are created by rendering threads; keep them off default queue */
+        display->frame_queue = wl_display_create_queue(display->display);
     }
 
     /* ...initialize inputs/outputs lists */
@@ -2087,6 +2569,9 @@ display_data_t * display_create(void)
     /* ...create a display command/response lock */
     pthread_mutex_init(&display->lock, NULL);
 
+    /* ...create dmabuf textures cache lock */
+    pthread_mutex_init(&display->dma_lock, NULL);
+
     /* ...create polling structure */
     if ((display->efd = epoll_create(DISPLAY_EVENTS_NUM)) < 0)
     {
@@ -2095,10 +2580,28 @@ display_data_t * display_create(void)
     }
 
     /* ...pre-initialize global Wayland interfaces */
-    do
+    while (display->display)
     {
         display->pending = 0, wl_display_roundtrip(display->display);
-    } while (display->pending);
+
+        if (!display->pending)
+        {
+            break;
+        }
+    }
+
+#if defined (PRESENTATION_TIME_ENABLED)
+    /* ...presentation feedback is requested from rendering threads */
+    if (display->presentation)
+    {
+        display->presentation_wrapper = wl_proxy_create_wrapper(display->presentation);
+        wl_proxy_set_queue((struct wl_proxy *)display->presentation_wrapper, display->frame_queue);
+    }
+    else
+    {
+        TRACE(INIT, _b("presentation timing is not supported; frame callbacks are used"));
+    }
+#endif
 
     /* ...initialize EGL */
     if (init_egl(display) < 0)
@@ -2114,9 +2617,26 @@ display_data_t * display_create(void)
     TRACE(INIT, _b("GL version: %s"), (char *) glGetString(GL_VERSION));
     TRACE(INIT, _b("GL extension: %s"), (char *) glGetString(GL_EXTENSIONS));
 
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    /* ...create YUV conversion program (shared by all contexts) */
+    if (__display_yuv_convert && texture_yuv_init(display) < 0)
+    {
+        TRACE(ERROR, _x("failed to create YUV conversion program"));
+        eglMakeCurrent(display->egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        goto error_disp;
+    }
+#endif
+
     /* ...release display EGL context */
     eglMakeCurrent(display->egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 
+    /* ...no events to dispatch in headless mode */
+    if (__display_headless)
+    {
+        TRACE(INIT, _b("headless display interface initialized"));
+        return display;
+    }
+
     /* ...initialize thread attributes (joinable, default stack size) */
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -2151,8 +2671,11 @@ error_egl:
 
 error_disp:
     /* ...disconnect display */
-    wl_display_flush(display->display);
-    wl_display_disconnect(display->display);
+    if (display->display)
+    {
+        wl_display_flush(display->display);
+        wl_display_disconnect(display->display);
+    }
 
 error:
     return NULL;
@@ -2231,8 +2754,8 @@ static inline int pixfmt_gst_to_drm_v4l2(int format)
     return ret;
 }
 
-/* ...texture creation (in shared display context) */
-static texture_data_t * texture_create_dma(vsink_meta_t* meta)
+/* ...dmabuf import (in shared display context) */
+static texture_data_t * texture_import_dma(vsink_meta_t* meta)
 {
     display_data_t         *display = &__display;
     EGLDisplay              dpy = display->egl.dpy;
@@ -2244,7 +2767,7 @@ static texture_data_t * texture_create_dma(vsink_meta_t* meta)
     int                     egl_format = 0;
 
     /* ...allocate texture data */
-    texture = malloc(sizeof(*texture));
+    texture = calloc(1, sizeof(*texture));
     if (texture == NULL)
     {
         TRACE(ERROR, _x("failed to allocate memory"));
@@ -2377,24 +2900,218 @@ error:
     free(texture);
     return NULL;
 }
-#endif
 
-#if defined(EGL_HAS_IMG_EXTERNAL_EXT)
-static void texture_set(int w, int h, int format, texture_data_t *texture)
+/* ...imported dmabuf cache entry */
+typedef struct texture_dma_cache
 {
-    GLenum target = TEXTURE_TARGET;
-    display_data_t *display = &__display;
-    EGLDisplay dpy = display->egl.dpy;
-    EGLImageKHR image;
-    DEFINE_PIXMAP(pixmap,
-                  w,
-                  h,
-                  pixfmt_gst_to_egl(format),
-                  texture->data[0]);
+    /* ...next entry in a list */
+    struct texture_dma_cache   *next;
 
-    texture->size[0] = __pixfmt_image_size(w, h, format);
-    image = eglCreateImageKHR(dpy,
-                              EGL_NO_CONTEXT,
+    /* ...dmabuf identity (per DMA file-descriptor) */
+    dev_t                       dev[GST_VIDEO_MAX_PLANES];
+    ino_t                       ino[GST_VIDEO_MAX_PLANES];
+    int                         offsets[GST_VIDEO_MAX_PLANES];
+    int                         n_dma;
+
+    /* ...image format */
+    int                         format, width, height;
+
+    /* ...buffers producer (video sink) */
+    void                       *owner;
+
+    /* ...imported texture (cache holds one reference) */
+    texture_data_t             *texture;
+
+}   texture_dma_cache_t;
+
+/* ...fill cache key for the buffer metadata */
+static int texture_dma_key(vsink_meta_t *meta, texture_dma_cache_t *key)
+{
+    struct stat st;
+    int i;
+
+    memset(key, 0, sizeof(*key));
+
+    for (i = 0; i < meta->n_dma; i++)
+    {
+        CHK_ERR(fstat(meta->dmafd[i], &st) == 0, -errno);
+        key->dev[i] = st.st_dev;
+        key->ino[i] = st.st_ino;
+        key->offsets[i] = meta->offsets[i];
+    }
+
+    key->n_dma = meta->n_dma;
+    key->format = meta->format;
+    key->width = meta->width;
+    key->height = meta->height;
+    key->owner = meta->sink;
+
+    return 0;
+}
+
+/* ...lookup cached texture and take a reference (called with cache lock held) */
+static texture_data_t * texture_dma_lookup(display_data_t *display, texture_dma_cache_t *key)
+{
+    texture_dma_cache_t *e;
+
+    for (e = display->dma_cache; e; e = e->next)
+    {
+        if (memcmp(e->dev, key->dev, sizeof(e->dev)) == 0 &&
+            memcmp(e->ino, key->ino, sizeof(e->ino)) == 0 &&
+            memcmp(e->offsets, key->offsets, sizeof(e->offsets)) == 0 &&
+            e->n_dma == key->n_dma &&
+            e->format == key->format &&
+            e->width == key->width &&
+            e->height == key->height &&
+            e->owner == key->owner)
+        {
+            e->texture->refcount++;
+            return e->texture;
+        }
+    }
+
+    return NULL;
+}
+
+/* ...texture creation for dmabuf-backed buffer (import is cached) */
+static texture_data_t * texture_create_dma(vsink_meta_t* meta)
+{
+    display_data_t *display = &__display;
+    texture_dma_cache_t key, *e;
+    texture_data_t *texture, *cached;
+
+    /* ...cannot identify the buffer; import it unconditionally */
+    if (texture_dma_key(meta, &key) < 0)
+    {
+        return texture_import_dma(meta);
+    }
+
+    pthread_mutex_lock(&display->dma_lock);
+    texture = texture_dma_lookup(display, &key);
+    (texture ? display->dma_hits++ : display->dma_misses++);
+    pthread_mutex_unlock(&display->dma_lock);
+
+    if (texture)
+    {
+        TRACE(DEBUG, _b("dmabuf texture %u reused (hits: %u, misses: %u)"), texture->tex, display->dma_hits, display->dma_misses);
+        return texture;
+    }
+
+    /* ...import buffer outside of the cache lock */
+    CHK_ERR(texture = texture_import_dma(meta), NULL);
+
+    CHK_ERR(e = malloc(sizeof(*e)), (texture_destroy(texture), errno = ENOMEM, NULL));
+
+    *e = key;
+    e->texture = texture;
+
+    pthread_mutex_lock(&display->dma_lock);
+
+    /* ...check if same buffer has been imported meanwhile */
+    if ((cached = texture_dma_lookup(display, &key)) != NULL)
+    {
+        pthread_mutex_unlock(&display->dma_lock);
+        texture_destroy(texture);
+        free(e);
+        return cached;
+    }
+
+    /* ...one reference is held by cache and another one by the caller */
+    texture->refcount = 2;
+    e->next = display->dma_cache;
+    display->dma_cache = e;
+
+    pthread_mutex_unlock(&display->dma_lock);
+
+    TRACE(DEBUG, _b("dmabuf texture %u cached (hits: %u, misses: %u)"), texture->tex, display->dma_hits, display->dma_misses);
+
+    return texture;
+}
+#endif
+
+/* ...drop texture reference; return number of remaining references */
+static inline int texture_unref(texture_data_t *texture)
+{
+    display_data_t *display = &__display;
+    int refcount;
+
+    /* ...texture is not shared */
+    if (texture->refcount == 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&display->dma_lock);
+    refcount = --texture->refcount;
+    pthread_mutex_unlock(&display->dma_lock);
+
+    return refcount;
+}
+
+/* ...drop imported dmabuf textures of particular producer (NULL - all) */
+void texture_cache_flush(void *owner)
+{
+    display_data_t *display = &__display;
+    struct texture_dma_cache *e, **p, *list = NULL;
+
+    /* ...detach matching entries; textures of other pipelines are kept */
+    pthread_mutex_lock(&display->dma_lock);
+
+    for (p = &display->dma_cache; (e = *p) != NULL; )
+    {
+        if (owner == NULL || e->owner == owner)
+        {
+            *p = e->next, e->next = list, list = e;
+        }
+        else
+        {
+            p = &e->next;
+        }
+    }
+
+    pthread_mutex_unlock(&display->dma_lock);
+
+    TRACE(INFO, _b("flush dmabuf textures cache of %p (hits: %u, misses: %u)"), owner, display->dma_hits, display->dma_misses);
+
+#if defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    while ((e = list) != NULL)
+    {
+        list = e->next;
+
+        /* ...release cache reference; texture is destroyed when last user is gone */
+        texture_destroy(e->texture);
+        free(e);
+    }
+#else
+    BUG(list != NULL, _x("unexpected dmabuf cache content"));
+#endif
+}
+
+/* ...retrieve dmabuf textures cache statistics */
+void texture_cache_stats(uint32_t *hits, uint32_t *misses)
+{
+    display_data_t *display = &__display;
+
+    *hits = display->dma_hits;
+    *misses = display->dma_misses;
+}
+
+#if defined(EGL_HAS_IMG_EXTERNAL_EXT)
+static void texture_set(int w, int h, int format, texture_data_t *texture)
+{
+    GLenum target = TEXTURE_TARGET;
+    display_data_t *display = &__display;
+    EGLDisplay dpy = display->egl.dpy;
+    EGLImageKHR image;
+    DEFINE_PIXMAP(pixmap,
+                  w,
+                  h,
+                  pixfmt_gst_to_egl(format),
+                  texture->data[0]);
+
+    texture->size[0] = __pixfmt_image_size(w, h, format);
+    image = eglCreateImageKHR(dpy,
+                              EGL_NO_CONTEXT,
                               EGL_NATIVE_PIXMAP_KHR,
                               (EGLClientBuffer)&pixmap,
                               NULL);
@@ -2406,11 +3123,314 @@ static void texture_set(int w, int h, int format, texture_data_t *texture)
     texture->pdata = image;
 }
 #else
+
+/*******************************************************************************
+ * Shader YUV to RGB conversion
+ ******************************************************************************/
+
+/* ...source layouts: semi-planar (NV12/NV16), packed UYVY and packed YUY2 */
+#define YUV_MODE_SEMIPLANAR             0
+#define YUV_MODE_UYVY                   1
+#define YUV_MODE_YUY2                   2
+
+static const char *__yuv_vs =
+    "attribute vec2 a_pos;\n"
+    "varying vec2 v_tex;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(a_pos, 0.0, 1.0);\n"
+    "    v_tex = a_pos * 0.5 + 0.5;\n"
+    "}\n";
+
+/* ...BT.601 limited range; packed formats keep two luma samples per texel */
+static const char *__yuv_fs =
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "varying vec2 v_tex;\n"
+    "uniform sampler2D u_luma;\n"
+    "uniform sampler2D u_chroma;\n"
+    "uniform int u_mode;\n"
+    "uniform float u_width;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 yuv;\n"
+    "    if (u_mode == 0)\n"
+    "    {\n"
+    "        yuv = vec3(texture2D(u_luma, v_tex).r, texture2D(u_chroma, v_tex).ra);\n"
+    "    }\n"
+    "    else\n"
+    "    {\n"
+    "        vec4 p = texture2D(u_luma, v_tex);\n"
+    "        float odd = step(0.5, fract(v_tex.x * u_width * 0.5));\n"
+    "        yuv = (u_mode == 1 ? vec3(mix(p.g, p.a, odd), p.r, p.b) : vec3(mix(p.r, p.b, odd), p.g, p.a));\n"
+    "    }\n"
+    "    yuv -= vec3(0.0625, 0.5, 0.5);\n"
+    "    gl_FragColor = vec4(mat3(1.1643, 1.1643, 1.1643, 0.0, -0.39173, 2.017, 1.5958, -0.8129, 0.0) * yuv, 1.0);\n"
+    "}\n";
+
+/* ...compile conversion shader */
+static GLuint texture_yuv_shader(GLenum type, const char *text)
+{
+    GLuint  shader = glCreateShader(type);
+    GLint   status;
+    char    log[256];
+
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+    if (!status)
+    {
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        TRACE(ERROR, _x("shader compilation failed: %s"), log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/* ...create conversion program (display context is current) */
+static int texture_yuv_init(display_data_t *display)
+{
+    GLuint  vs, fs, program;
+    GLint   status;
+
+    CHK_ERR(vs = texture_yuv_shader(GL_VERTEX_SHADER, __yuv_vs), -EINVAL);
+
+    if ((fs = texture_yuv_shader(GL_FRAGMENT_SHADER, __yuv_fs)) == 0)
+    {
+        glDeleteShader(vs);
+        return -EINVAL;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+    /* ...shaders are kept by program */
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    if (!status)
+    {
+        TRACE(ERROR, _x("program linking failed"));
+        glDeleteProgram(program);
+        return -EINVAL;
+    }
+
+    display->yuv_program = program;
+    display->yuv_a_pos = glGetAttribLocation(program, "a_pos");
+    display->yuv_u_luma = glGetUniformLocation(program, "u_luma");
+    display->yuv_u_chroma = glGetUniformLocation(program, "u_chroma");
+    display->yuv_u_mode = glGetUniformLocation(program, "u_mode");
+    display->yuv_u_width = glGetUniformLocation(program, "u_width");
+    display->yuv_unpack_subimage = (strstr((const char *)glGetString(GL_EXTENSIONS) ? : "", "GL_EXT_unpack_subimage") != NULL);
+
+    TRACE(INIT, _b("YUV conversion program created: %u"), program);
+
+    return 0;
+}
+
+/* ...source textures layout; returns number of textures */
+static int texture_yuv_planes(texture_data_t *texture, int *mode, GLenum *format, int *w, int *h)
+{
+    int     W = texture->width, H = texture->height;
+
+    switch (texture->yuv_format)
+    {
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV16:
+        *mode = YUV_MODE_SEMIPLANAR;
+        format[0] = GL_LUMINANCE, w[0] = W, h[0] = H;
+        format[1] = GL_LUMINANCE_ALPHA, w[1] = W / 2;
+        h[1] = (texture->yuv_format == GST_VIDEO_FORMAT_NV12 ? H / 2 : H);
+        return 2;
+
+    case GST_VIDEO_FORMAT_UYVY:
+    case GST_VIDEO_FORMAT_YUY2:
+        *mode = (texture->yuv_format == GST_VIDEO_FORMAT_UYVY ? YUV_MODE_UYVY : YUV_MODE_YUY2);
+        format[0] = GL_RGBA, w[0] = W / 2, h[0] = H;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* ...upload source plane of given line length (bound texture) */
+static void texture_yuv_upload(int w, int h, GLenum format, int stride, const u8 *data)
+{
+    int bpp = (format == GL_LUMINANCE ? 1 : format == GL_LUMINANCE_ALPHA ? 2 : 4);
+    int y;
+
+    if (stride == w * bpp)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, GL_UNSIGNED_BYTE, data);
+    }
+    else if (__display.yuv_unpack_subimage)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / bpp);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+    }
+    else
+    {
+        /* ...padded lines cannot be described to GL; upload them one by one */
+        for (y = 0; y < h; y++)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, w, 1, format, GL_UNSIGNED_BYTE, data + y * stride);
+        }
+    }
+}
+
+/* ...upload source planes and render them into RGB texture (GL context is current) */
+static void texture_yuv_update(texture_data_t *texture)
+{
+    static const GLfloat quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+    display_data_t *display = &__display;
+    const void *plane[2];
+    GLenum format[2];
+    int w[2], h[2], mode, n, i, stride;
+    GLint fbo, program, viewport[4], vao = 0, vbo, unit, tex[2];
+    GLboolean blend, depth, cull, scissor;
+    GLuint id;
+
+    n = texture_yuv_planes(texture, &mode, format, w, h);
+
+    /* ...both planes of semi-planar formats have the same line length */
+    stride = texture->stride ? : (mode == YUV_MODE_SEMIPLANAR ? texture->width : texture->width * 2);
+
+    /* ...chroma plane follows luma unless buffer provides it separately */
+    plane[0] = texture->data[0];
+    plane[1] = texture->data[1] ?: (u8 *)texture->data[0] + stride * texture->height;
+
+    /* ...save state we are going to change */
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+
+    for (i = 0; i < n; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex[i]);
+        glBindTexture(GL_TEXTURE_2D, texture->yuv[i]);
+        texture_yuv_upload(w[i], h[i], format[i], stride, plane[i]);
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &vbo);
+    (glBindVertexArrayOES ? glGetIntegerv(GL_VERTEX_ARRAY_BINDING_OES, &vao) : (void)0);
+    blend = glIsEnabled(GL_BLEND);
+    depth = glIsEnabled(GL_DEPTH_TEST);
+    cull = glIsEnabled(GL_CULL_FACE);
+    scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+    /* ...framebuffer objects are not shared between contexts; use transient one */
+    glGenFramebuffers(1, &id);
+    glBindFramebuffer(GL_FRAMEBUFFER, id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->tex, 0);
+
+    glViewport(0, 0, texture->width, texture->height);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_SCISSOR_TEST);
+
+    /* ...vertex attributes must not go into engine's vertex array object */
+    (glBindVertexArrayOES ? glBindVertexArrayOES(0) : (void)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(display->yuv_program);
+    glUniform1i(display->yuv_u_luma, 0);
+    glUniform1i(display->yuv_u_chroma, 1);
+    glUniform1i(display->yuv_u_mode, mode);
+    glUniform1f(display->yuv_u_width, texture->width);
+
+    glVertexAttribPointer(display->yuv_a_pos, 2, GL_FLOAT, GL_FALSE, 0, quad);
+    glEnableVertexAttribArray(display->yuv_a_pos);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(display->yuv_a_pos);
+
+    /* ...restore state */
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glDeleteFramebuffers(1, &id);
+    glUseProgram(program);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    (blend ? glEnable(GL_BLEND) : (void)0);
+    (depth ? glEnable(GL_DEPTH_TEST) : (void)0);
+    (cull ? glEnable(GL_CULL_FACE) : (void)0);
+    (scissor ? glEnable(GL_SCISSOR_TEST) : (void)0);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    (glBindVertexArrayOES ? glBindVertexArrayOES(vao) : (void)0);
+
+    for (i = n; i-- > 0; )
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, tex[i]);
+    }
+
+    glActiveTexture(unit);
+}
+
+/* ...allocate RGB texture and its YUV sources (texture is bound) */
+static void texture_set_yuv(int w, int h, int format, texture_data_t *texture)
+{
+    GLenum target = TEXTURE_TARGET;
+    GLenum fmt[2];
+    int pw[2], ph[2], mode, n, i;
+
+    texture->size[0] = __pixfmt_image_size(w, h, format);
+    texture->pdata = NULL;
+    texture->yuv_format = format;
+    texture->format = GL_RGBA;
+    texture->width = w;
+    texture->height = h;
+
+    n = texture_yuv_planes(texture, &mode, fmt, pw, ph);
+    BUG(n == 0, _x("not supported format: %d"), format);
+
+    /* ...conversion output */
+    glTexImage2D(target, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    /* ...packed formats must not be filtered (neighbour texels carry other pixels) */
+    glGenTextures(n, texture->yuv);
+
+    for (i = 0; i < n; i++)
+    {
+        GLint filter = (mode == YUV_MODE_SEMIPLANAR ? GL_LINEAR : GL_NEAREST);
+
+        glBindTexture(target, texture->yuv[i]);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+        glTexImage2D(target, 0, fmt[i], pw[i], ph[i], 0, fmt[i], GL_UNSIGNED_BYTE, NULL);
+    }
+
+    /* ...convert initial content */
+    texture_yuv_update(texture);
+
+    glBindTexture(target, texture->tex);
+}
+
 static void texture_set(int w, int h, int format, texture_data_t *texture)
 {
     GLenum target = TEXTURE_TARGET;
     GLint internal_format;
 
+    /* ...convert into RGB texture by a shader */
+    if (__display_yuv_convert)
+    {
+        texture_set_yuv(w, h, format, texture);
+        return;
+    }
+
     texture->size[0] = __pixfmt_image_size(w, h, format);
 
     texture->pdata = NULL;
@@ -2424,6 +3444,13 @@ static void texture_set(int w, int h, int format, texture_data_t *texture)
         texture->height = (h * 3) / 2;
         break;
 
+    case GST_VIDEO_FORMAT_NV16:
+        internal_format = GL_ALPHA;
+        texture->format = GL_ALPHA;
+        texture->width = w;
+        texture->height = h * 2;
+        break;
+
     case GST_VIDEO_FORMAT_UYVY:
     case GST_VIDEO_FORMAT_YUY2:
         internal_format = GL_RG8_EXT;
@@ -2457,7 +3484,7 @@ texture_data_t * texture_create_pixmap(vsink_meta_t* meta)
     GLenum target = TEXTURE_TARGET;
 
     /* ...allocate texture data */
-    texture = malloc(sizeof (*texture));
+    texture = calloc(1, sizeof(*texture));
     if (texture == NULL)
     {
         TRACE(ERROR, _x("failed to allocate memory"));
@@ -2476,6 +3503,7 @@ texture_data_t * texture_create_pixmap(vsink_meta_t* meta)
 
     /* ...save planes buffers pointers */
     memcpy(texture->data, meta->plane, sizeof (texture->data));
+    texture->stride = meta->stride[0];
 
     /* ...bind texture to the output device */
     glBindTexture(target, texture->tex);
@@ -2520,6 +3548,7 @@ int texture_update(texture_data_t *texture)
     EGLint ret;
     GLenum target = TEXTURE_TARGET;
     EGLContext ctx = eglGetCurrentContext();
+    u32 t0 = get_time_usec();
 
     /* ...get display shared context */
     if (ctx == EGL_NO_CONTEXT)
@@ -2527,27 +3556,38 @@ int texture_update(texture_data_t *texture)
         display_egl_ctx_get(display);
     }
 
-    glBindTexture(target, texture->tex);
-    glTexSubImage2D(target,
-                    0,
-                    0,
-                    0,
-                    texture->width,
-                    texture->height,
-                    texture->format,
-                    GL_UNSIGNED_BYTE,
-                    texture->data[0]);
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    /* ...render buffer content into RGB texture (bindings are preserved) */
+    if (texture->yuv[0])
+    {
+        texture_yuv_update(texture);
+    }
+    else
+#endif
+    {
+        glBindTexture(target, texture->tex);
+        glTexSubImage2D(target,
+                        0,
+                        0,
+                        0,
+                        texture->width,
+                        texture->height,
+                        texture->format,
+                        GL_UNSIGNED_BYTE,
+                        texture->data[0]);
+        glBindTexture(target, 0);
+    }
 
     ret = glGetError();
     TRACE(DEBUG, _b("texture update from: %p, err: %#x"), texture->data[0], ret);
 
-    glBindTexture(target, 0);
-
     if (ctx == EGL_NO_CONTEXT)
     {
         display_egl_ctx_put(display);
     }
 
+    texture->upload_time = get_time_usec() - t0;
+
     return ret;
 }
 
@@ -2555,7 +3595,15 @@ int texture_update(texture_data_t *texture)
 void texture_destroy(texture_data_t *texture)
 {
     display_data_t *display = &__display;
-    EGLContext ctx = eglGetCurrentContext();
+    EGLContext ctx;
+
+    /* ...shared texture is still in use */
+    if (texture_unref(texture) > 0)
+    {
+        return;
+    }
+
+    ctx = eglGetCurrentContext();
 
     /* ...get display shared context */
     if (ctx == EGL_NO_CONTEXT)
@@ -2566,12 +3614,23 @@ void texture_destroy(texture_data_t *texture)
     /* ...destroy textures */
     glDeleteTextures(1, &texture->tex);
 
+    if (texture->yuv[0])
+    {
+        glDeleteTextures(texture->yuv[1] ? 2 : 1, texture->yuv);
+    }
+
     /* ...destroy EGL images */
     if (texture->pdata)
     {
         eglDestroyImageKHR(display->egl.dpy, texture->pdata);
     }
 
+    /* ...destroy pending upload fence */
+    if (texture->sync != EGL_NO_SYNC_KHR)
+    {
+        eglDestroySyncKHR(display->egl.dpy, texture->sync);
+    }
+
     /* ...release shared display context */
     if (ctx == EGL_NO_CONTEXT)
     {
@@ -2581,3 +3640,426 @@ void texture_destroy(texture_data_t *texture)
     /* ...destroy texture structure */
     free(texture);
 }
+
+/* ...maximal time renderer may block on an upload fence (ns) */
+#define TEXTURE_WAIT_TIMEOUT            (5 * 1000000ULL)
+
+/* ...wait for completion of asynchronous texture upload */
+int texture_wait(texture_data_t *texture)
+{
+    display_data_t *display = &__display;
+    EGLSyncKHR sync = texture->sync;
+    EGLint ret;
+
+    /* ...no upload is pending */
+    if (sync == EGL_NO_SYNC_KHR)
+    {
+        return 0;
+    }
+
+    /* ...let GPU wait for the upload; renderer thread is not blocked */
+    if (eglWaitSyncKHR != NULL)
+    {
+        texture->sync = EGL_NO_SYNC_KHR;
+
+        ret = eglWaitSyncKHR(display->egl.dpy, sync, 0);
+
+        eglDestroySyncKHR(display->egl.dpy, sync);
+
+        if (ret != EGL_TRUE)
+        {
+            TRACE(ERROR, _x("texture %u fence wait failed: %X"), texture->tex, eglGetError());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    ret = eglClientWaitSyncKHR(display->egl.dpy, sync, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, TEXTURE_WAIT_TIMEOUT);
+
+    /* ...upload is still in progress; keep the fence and let caller retain previous frame */
+    if (ret == EGL_TIMEOUT_EXPIRED_KHR)
+    {
+        TRACE(WARNING, _b("texture %u upload is not complete in %llu ns"), texture->tex, TEXTURE_WAIT_TIMEOUT);
+        return 1;
+    }
+
+    texture->sync = EGL_NO_SYNC_KHR;
+
+    eglDestroySyncKHR(display->egl.dpy, sync);
+
+    if (ret != EGL_CONDITION_SATISFIED_KHR)
+    {
+        TRACE(ERROR, _x("texture %u fence wait failed: %X"), texture->tex, eglGetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+ * Asynchronous textures upload
+ ******************************************************************************/
+
+/* ...number of pixel-buffer objects used in round-robin fashion */
+#define TEXTURE_UPLOAD_PBO_NUMBER       2
+
+/* ...upload request */
+typedef struct texture_upload_job
+{
+    /* ...request originator identifier */
+    int                 id;
+
+    /* ...texture to update from its data pointers */
+    texture_data_t     *texture;
+
+    /* ...completion callback private data */
+    void               *priv;
+
+}   texture_upload_job_t;
+
+/* ...upload thread data */
+struct texture_upload
+{
+    /* ...upload context (shared with display context) */
+    EGLContext          ctx;
+
+    /* ...upload thread handle */
+    pthread_t           thread;
+
+    /* ...requests queue protection */
+    pthread_mutex_t     lock;
+
+    /* ...requests availability condition */
+    pthread_cond_t      wait;
+
+    /* ...pending requests queue */
+    GQueue              queue;
+
+    /* ...thread activity flag */
+    int                 active;
+
+    /* ...upload completion callback */
+    void              (*done)(void *cdata, int id, void *priv);
+
+    /* ...completion callback client data */
+    void               *cdata;
+
+#if defined (TEXTURE_UPLOAD_PBO)
+    /* ...pixel-buffer objects for asynchronous DMA transfer */
+    GLuint              pbo[TEXTURE_UPLOAD_PBO_NUMBER];
+
+    /* ...next pixel-buffer object to use */
+    int                 pbo_idx;
+#endif
+};
+
+/* ...upload texture content and create completion fence (upload context is current) */
+static void texture_upload_process(texture_upload_t *upload, texture_data_t *texture)
+{
+    display_data_t *display = &__display;
+    GLenum target = TEXTURE_TARGET;
+    u32 t0 = get_time_usec();
+
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    /* ...conversion reads planes directly; staging is not used */
+    if (texture->yuv[0])
+    {
+        texture_yuv_update(texture);
+    }
+    else
+#endif
+    {
+        glBindTexture(target, texture->tex);
+
+#if defined (TEXTURE_UPLOAD_PBO)
+        /* ...stage buffer content into pixel-buffer object; transfer is done by GPU */
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload->pbo[upload->pbo_idx]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, texture->size[0], texture->data[0], GL_STREAM_DRAW);
+        glTexSubImage2D(target, 0, 0, 0, texture->width, texture->height, texture->format, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        upload->pbo_idx = (upload->pbo_idx + 1) % TEXTURE_UPLOAD_PBO_NUMBER;
+#else
+        glTexSubImage2D(target, 0, 0, 0, texture->width, texture->height, texture->format, GL_UNSIGNED_BYTE, texture->data[0]);
+#endif
+
+        glBindTexture(target, 0);
+    }
+
+    /* ...previous upload result has not been consumed; drop its fence */
+    if (texture->sync != EGL_NO_SYNC_KHR)
+    {
+        eglDestroySyncKHR(display->egl.dpy, texture->sync);
+        texture->sync = EGL_NO_SYNC_KHR;
+    }
+
+    /* ...insert fence for a renderer; fall back to synchronous completion */
+    if (eglCreateSyncKHR != NULL)
+    {
+        texture->sync = eglCreateSyncKHR(display->egl.dpy, EGL_SYNC_FENCE_KHR, NULL);
+    }
+
+    (texture->sync != EGL_NO_SYNC_KHR ? glFlush() : glFinish());
+
+    texture->upload_time = get_time_usec() - t0;
+
+    TRACE(DEBUG, _b("texture %u upload from %p submitted, fence: %p"), texture->tex, texture->data[0], texture->sync);
+}
+
+/* ...upload thread */
+static void * texture_upload_thread(void *arg)
+{
+    texture_upload_t *upload = arg;
+    display_data_t *display = &__display;
+    texture_upload_job_t *job;
+
+    /* ...upload context is surfaceless */
+    eglMakeCurrent(display->egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, upload->ctx);
+
+#if defined (TEXTURE_UPLOAD_PBO)
+    glGenBuffers(TEXTURE_UPLOAD_PBO_NUMBER, upload->pbo);
+#endif
+
+    while (1)
+    {
+        pthread_mutex_lock(&upload->lock);
+
+        /* ...wait for a request; drain the queue before termination */
+        while (g_queue_is_empty(&upload->queue) && upload->active)
+        {
+            pthread_cond_wait(&upload->wait, &upload->lock);
+        }
+
+        job = g_queue_pop_head(&upload->queue);
+
+        pthread_mutex_unlock(&upload->lock);
+
+        if (job == NULL)
+        {
+            break;
+        }
+
+        texture_upload_process(upload, job->texture);
+
+        /* ...pass result to the client */
+        upload->done(upload->cdata, job->id, job->priv);
+
+        free(job);
+    }
+
+#if defined (TEXTURE_UPLOAD_PBO)
+    glDeleteBuffers(TEXTURE_UPLOAD_PBO_NUMBER, upload->pbo);
+#endif
+
+    eglMakeCurrent(display->egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    TRACE(INIT, _b("texture upload thread terminated"));
+
+    return NULL;
+}
+
+/* ...create upload thread */
+texture_upload_t * texture_upload_create(void (*done)(void *cdata, int id, void *priv),
+                                         void *cdata)
+{
+    display_data_t *display = &__display;
+    texture_upload_t *upload;
+    pthread_attr_t attr;
+    int r;
+
+    CHK_ERR(upload = calloc(1, sizeof(*upload)), (errno = ENOMEM, NULL));
+
+    /* ...create upload context sharing objects with display context */
+    upload->ctx = eglCreateContext(display->egl.dpy, display->egl.conf, display->egl.ctx, __egl_context_attribs);
+    if (upload->ctx == EGL_NO_CONTEXT)
+    {
+        TRACE(ERROR, _x("failed to create upload context: %X"), eglGetError());
+        errno = ENOMEM;
+        goto error;
+    }
+
+    upload->done = done;
+    upload->cdata = cdata;
+    upload->active = 1;
+    g_queue_init(&upload->queue);
+    pthread_mutex_init(&upload->lock, NULL);
+    pthread_cond_init(&upload->wait, NULL);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    r = pthread_create(&upload->thread, &attr, texture_upload_thread, upload);
+    pthread_attr_destroy(&attr);
+
+    if (r != 0)
+    {
+        TRACE(ERROR, _x("failed to create upload thread: %d"), r);
+        errno = r;
+        goto error_ctx;
+    }
+
+    TRACE(INIT, _b("texture upload thread created (%s)"),
+#if defined (TEXTURE_UPLOAD_PBO)
+          "pixel-buffer objects"
+#else
+          "direct"
+#endif
+          );
+
+    return upload;
+
+error_ctx:
+    pthread_cond_destroy(&upload->wait);
+    pthread_mutex_destroy(&upload->lock);
+    eglDestroyContext(display->egl.dpy, upload->ctx);
+
+error:
+    free(upload);
+    return NULL;
+}
+
+/* ...submit texture upload request */
+int texture_upload_submit(texture_upload_t *upload,
+                          int id,
+                          texture_data_t *texture,
+                          void *priv)
+{
+    texture_upload_job_t *job;
+
+    CHK_ERR(job = malloc(sizeof(*job)), -(errno = ENOMEM));
+
+    job->id = id;
+    job->texture = texture;
+    job->priv = priv;
+
+    pthread_mutex_lock(&upload->lock);
+    g_queue_push_tail(&upload->queue, job);
+    pthread_cond_signal(&upload->wait);
+    pthread_mutex_unlock(&upload->lock);
+
+    return 0;
+}
+
+/* ...complete pending requests and destroy upload thread */
+void texture_upload_destroy(texture_upload_t *upload)
+{
+    display_data_t *display = &__display;
+
+    pthread_mutex_lock(&upload->lock);
+    upload->active = 0;
+    pthread_cond_signal(&upload->wait);
+    pthread_mutex_unlock(&upload->lock);
+
+    pthread_join(upload->thread, NULL);
+
+    pthread_cond_destroy(&upload->wait);
+    pthread_mutex_destroy(&upload->lock);
+    eglDestroyContext(display->egl.dpy, upload->ctx);
+
+    free(upload);
+}
+
+/*******************************************************************************
+ * GPU timer queries
+ ******************************************************************************/
+
+/* ...number of queries in flight (results are collected with a few frames delay) */
+#define GPU_TIMER_QUERIES               4
+
+struct gpu_timer
+{
+    /* ...query objects ring */
+    GLuint              query[GPU_TIMER_QUERIES];
+
+    /* ...number of queries issued and collected */
+    u32                 issued, collected;
+
+    /* ...measurement in progress */
+    int                 active;
+};
+
+/* ...create GPU timer (window context is current) */
+gpu_timer_t * gpu_timer_create(void)
+{
+    const char     *ext = (const char *)glGetString(GL_EXTENSIONS);
+    gpu_timer_t    *timer;
+    GLint           disjoint;
+
+    /* ...check if timer queries are supported */
+    if (!ext || !strstr(ext, "GL_EXT_disjoint_timer_query") || !glGenQueriesEXT)
+    {
+        TRACE(INIT, _b("GPU timer queries not supported"));
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    CHK_ERR(timer = calloc(1, sizeof(*timer)), (errno = ENOMEM, NULL));
+
+    glGenQueriesEXT(GPU_TIMER_QUERIES, timer->query);
+
+    /* ...clear disjoint state before first measurement */
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    TRACE(INIT, _b("GPU timer created: %p"), timer);
+
+    return timer;
+}
+
+/* ...destroy GPU timer (window context is current) */
+void gpu_timer_destroy(gpu_timer_t *timer)
+{
+    glDeleteQueriesEXT(GPU_TIMER_QUERIES, timer->query);
+
+    free(timer);
+}
+
+/* ...start measurement; skipped if all queries are still in flight */
+void gpu_timer_begin(gpu_timer_t *timer)
+{
+    if (timer->issued - timer->collected < GPU_TIMER_QUERIES)
+    {
+        glBeginQueryEXT(GL_TIME_ELAPSED_EXT, timer->query[timer->issued % GPU_TIMER_QUERIES]);
+        timer->active = 1;
+    }
+}
+
+/* ...complete measurement */
+void gpu_timer_end(gpu_timer_t *timer)
+{
+    if (timer->active)
+    {
+        glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+        timer->issued++, timer->active = 0;
+    }
+}
+
+/* ...collect available results without stalling the pipeline */
+int gpu_timer_collect(gpu_timer_t *timer, uint32_t *acc)
+{
+    GLint       available, disjoint = 0;
+    GLuint64    elapsed;
+    int         n = 0;
+
+    while (timer->collected != timer->issued)
+    {
+        GLuint  query = timer->query[timer->collected % GPU_TIMER_QUERIES];
+
+        glGetQueryObjectivEXT(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available)
+        {
+            break;
+        }
+
+        glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT_EXT, &elapsed);
+        timer->collected++;
+
+        /* ...results are meaningless if GPU clock has been disturbed (e.g. frequency change) */
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (!disjoint)
+        {
+            *acc += (uint32_t)(elapsed / 1000), n++;
+        }
+    }
+
+    return n;
+}
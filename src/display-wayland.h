@@ -53,10 +53,12 @@ extern PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC eglSwapBuffersWithDamageEXT;
 extern PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 extern PFNGLMAPBUFFEROESPROC glMapBufferOES;
 extern PFNGLUNMAPBUFFEROESPROC glUnmapBufferOES;
+extern PFNGLBINDVERTEXARRAYOESPROC glBindVertexArrayOES;
 
 extern PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
 extern PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
 extern PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+extern PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
 
 /*******************************************************************************
  * Types definitions
@@ -237,8 +237,38 @@ struct texture_data
 
     /* ...texture height */
     int                 height;
+
+    /* ...pending asynchronous upload fence */
+    EGLSyncKHR          sync;
+
+    /* ...number of references to a shared (cached) texture; 0 if not shared */
+    int                 refcount;
+
+    /* ...duration of the last content upload (usec) */
+    uint32_t            upload_time;
+
+    /* ...source luma/chroma textures for shader YUV conversion (0 if not used) */
+    uint32_t            yuv[2];
+
+    /* ...source pixel format for shader YUV conversion */
+    int                 yuv_format;
+
+    /* ...source line length (bytes; 0 - tightly packed) */
+    int                 stride;
 };
 
+/* ...asynchronous texture upload context */
+typedef struct texture_upload       texture_upload_t;
+
+/* ...offscreen rendering without a compositor */
+extern int __display_headless;
+
+/* ...frame pacing using presentation feedback */
+extern int __display_pacing;
+
+/* ...convert YUV camera buffers into RGB textures by a shader */
+extern int __display_yuv_convert;
+
 /* ...connect to a display */
 extern display_data_t * display_create(void);
 
@@ -253,6 +283,7 @@ extern void window_destroy(window_data_t *window);
 /* ...schedule window redrawal */
 extern void window_schedule_redraw(window_data_t *window);
 extern void window_draw(window_data_t *window);
+extern void window_draw_damage(window_data_t *window, const int *rects, int n);
 extern void window_clear(window_data_t *window);
 
 
@@ -272,6 +303,8 @@ extern cairo_matrix_t * window_get_cmatrix(window_data_t *window);
 /* ...auxiliary helpers */
 extern void window_frame_rate_reset(window_data_t *window);
 extern float window_frame_rate_update(window_data_t *window);
+extern int window_present_stats(window_data_t *window, uint32_t *period, uint32_t *avg, uint32_t *max, int *presented);
+extern int window_is_visible(window_data_t *window);
 
 extern int __check_surface(cairo_surface_t *cs);
 
@@ -281,6 +314,40 @@ extern int texture_update(texture_data_t *texture);
 
 extern void texture_destroy(texture_data_t *texture);
 
+/* ...imported dmabuf textures cache */
+extern void texture_cache_flush(void *owner);
+extern void texture_cache_stats(uint32_t *hits, uint32_t *misses);
+
+/* ...wait for completion of asynchronous texture upload (positive - still pending) */
+extern int texture_wait(texture_data_t *texture);
+
+/* ...asynchronous texture upload thread */
+extern texture_upload_t * texture_upload_create(void (*done)(void *cdata, int id, void *priv),
+                                                void *cdata);
+extern int texture_upload_submit(texture_upload_t *upload,
+                                 int id,
+                                 texture_data_t *texture,
+                                 void *priv);
+extern void texture_upload_destroy(texture_upload_t *upload);
+
+/*******************************************************************************
+ * GPU timing support
+ ******************************************************************************/
+
+/* ...GPU elapsed-time queries context */
+typedef struct gpu_timer            gpu_timer_t;
+
+/* ...create timer in current context (NULL if timer queries are not supported) */
+extern gpu_timer_t * gpu_timer_create(void);
+extern void gpu_timer_destroy(gpu_timer_t *timer);
+
+/* ...bracket GL commands to measure */
+extern void gpu_timer_begin(gpu_timer_t *timer);
+extern void gpu_timer_end(gpu_timer_t *timer);
+
+/* ...accumulate completed measurements (usec); returns number of results */
+extern int gpu_timer_collect(gpu_timer_t *timer, uint32_t *acc);
+
 /*******************************************************************************
  * Generic widgets support
  ******************************************************************************/
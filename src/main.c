@@ -87,6 +87,89 @@ char                *__stream_file = NULL;
 /* ...Streaming base port */
 int                 __stream_base_port = 0;
 
+/* ...event recording pre-trigger and post-trigger intervals (seconds) */
+int                 __stream_event_pre = 10;
+int                 __stream_event_post = 5;
+
+/* ...pass exported camera buffers to streaming pipelines as DMA buffers */
+int                 __stream_dmabuf = 0;
+
+/* ...maximal number of buffers queued for encoding per camera */
+int                 __stream_queue = 2;
+
+/* ...H.264 encoder back-end (auto, omx, x264, openh264) */
+char               *__stream_encoder = "auto";
+
+/* ...uplink budget of all streamed cameras (kbit/s; 0 - fixed encoder bitrate) */
+int                 __stream_budget = 0;
+
+/* ...UDP port receiving loss reports of stream receivers (0 - disabled) */
+int                 __stream_feedback_port = 0;
+
+/* ...control socket path (NULL - message queue only) */
+char               *__stream_control_socket = NULL;
+
+/* ...recording output directory */
+char                *__record_dir = ".";
+
+/* ...recording segment duration (seconds) and size (MB) limits; 0 - single file */
+int                 __record_segment_time = 0;
+int                 __record_segment_size = 0;
+
+/* ...number of segments kept per camera (0 - unlimited) */
+int                 __record_keep = 0;
+
+/* ...preallocate segment files and flush them behind the writer */
+int                 __record_prealloc = 0;
+
+/* ...per-device VIN capturing threads */
+int                 __vin_threads = 0;
+
+/* ...VIN capturing threads real-time priority (0 - default policy) */
+int                 __vin_priority = 0;
+
+/* ...VIN capturing threads CPU affinity (-1 - not pinned) */
+int                 __vin_affinity[CAMERAS_NUMBER] = { -1, -1, -1, -1 };
+
+/* ...eventfd-based VIN capturing threads shutdown */
+int                 __vin_eventfd = 0;
+
+/* ...number of buffers per VIN device (0 - default) */
+int                 __vin_buffers = 0;
+
+/* ...VIN capturing pixel format */
+int                 __vin_format = GST_VIDEO_FORMAT_UYVY;
+
+/* ...VIN capturing frame rate (0 - driver default) */
+int                 __vin_fps = 0;
+
+/* ...benchmark report interval (in seconds) */
+int                 __benchmark_interval = 0;
+
+/* ...cameras synchronization window (ms, 0 - take newest frames) */
+int                 __sync_window = 0;
+
+/* ...maximal time to wait for a synchronized set (ms, 0 - use best available) */
+int                 __sync_wait = 0;
+
+/* ...upload textures from a dedicated thread */
+int                 __async_upload = 0;
+
+/* ...pass frames to renderer through per-camera mailboxes instead of queues */
+int                 __render_mailbox = 0;
+
+/* ...rendering rate while paused or hidden (frames per second) */
+int                 __idle_fps = 2;
+
+/* ...offscreen rendering without a compositor */
+int                 __display_headless = 0;
+
+/* ...frame pacing using presentation feedback */
+int                 __display_pacing = 0;
+
+/* ...convert YUV camera buffers into RGB textures by a shader */
+int                 __display_yuv_convert = 0;
+
 /* ...global configuration data */
 static sview_cfg_t      __sv_cfg =
 {
@@ -399,6 +482,20 @@ static inline int open_vin_descriptors(sview_cfg_t* cfg, char **name)
     return 0;
 }
 
+/* ...parse CPU affinity list (missing entries leave threads unpinned) */
+static inline int parse_cpu_list(char *str, int *cpu, int n)
+{
+    char   *s;
+
+    for (s = strtok(str, ","); n > 0 && s; n--, s = strtok(NULL, ","))
+    {
+        /* ...negative value means "no affinity" */
+        CHK_ERR(sscanf(s, "%d", cpu++) == 1, -EINVAL);
+    }
+
+    return 0;
+}
+
 /* ...parse video stream file names */
 static inline int parse_video_file_names(char *str, char **name, int n)
 {
@@ -472,6 +569,31 @@ static inline int parse_format(char *str)
     }
 }
 
+/* ...parse VIN capturing format */
+static inline int parse_vin_format(char *str)
+{
+    if (strcasecmp(str, "uyvy") == 0)
+    {
+        return GST_VIDEO_FORMAT_UYVY;
+    }
+    else if (strcasecmp(str, "yuyv") == 0)
+    {
+        return GST_VIDEO_FORMAT_YUY2;
+    }
+    else if (strcasecmp(str, "nv12") == 0)
+    {
+        return GST_VIDEO_FORMAT_NV12;
+    }
+    else if (strcasecmp(str, "nv16") == 0)
+    {
+        return GST_VIDEO_FORMAT_NV16;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
 /* ...configuration file parsing */
 static int parse_cfg_file(char *name)
 {
@@ -590,6 +712,36 @@ enum surround_view_options
     OPT_EXTRINSICS_CIRCLES_PARAM,
     OPT_PROTO,
     OPT_PDU_SUBTYPE,
+    OPT_VIN_THREADS,
+    OPT_VIN_PRIORITY,
+    OPT_VIN_AFFINITY,
+    OPT_VIN_EVENTFD,
+    OPT_VIN_BUFFERS,
+    OPT_VIN_FORMAT,
+    OPT_VIN_FPS,
+    OPT_BENCHMARK,
+    OPT_SYNC_WINDOW,
+    OPT_SYNC_WAIT,
+    OPT_ASYNC_UPLOAD,
+    OPT_HEADLESS,
+    OPT_FRAME_PACING,
+    OPT_HUD,
+    OPT_YUV_CONVERT,
+    OPT_MAILBOX,
+    OPT_IDLE_FPS,
+    OPT_EVENT_PREROLL,
+    OPT_EVENT_POSTROLL,
+    OPT_RECORD_DIR,
+    OPT_RECORD_SEGMENT,
+    OPT_RECORD_SEGMENT_SIZE,
+    OPT_RECORD_KEEP,
+    OPT_RECORD_PREALLOC,
+    OPT_STREAM_DMABUF,
+    OPT_STREAM_QUEUE,
+    OPT_STREAM_ENCODER,
+    OPT_STREAM_BUDGET,
+    OPT_STREAM_FEEDBACK,
+    OPT_CONTROL_SOCKET,
     OPT_STREAMING_IP = 'I',
     OPT_STREAMING_PORT = 'P',
     OPT_RECORDING_FILENAME = 'F'
@@ -642,10 +794,44 @@ static const struct option    options[] = {
     {   "proto",  required_argument,  NULL, OPT_PROTO },
     {   "pdu-subtype",  required_argument,  NULL, OPT_PDU_SUBTYPE },
 
+    /* ...VIN capturing options */
+    {   "vin-threads",            no_argument,        NULL, OPT_VIN_THREADS },
+    {   "vin-priority",           required_argument,  NULL, OPT_VIN_PRIORITY },
+    {   "vin-affinity",           required_argument,  NULL, OPT_VIN_AFFINITY },
+    {   "vin-eventfd",            no_argument,        NULL, OPT_VIN_EVENTFD },
+    {   "vin-buffers",            required_argument,  NULL, OPT_VIN_BUFFERS },
+    {   "vin-format",             required_argument,  NULL, OPT_VIN_FORMAT },
+    {   "vin-fps",                required_argument,  NULL, OPT_VIN_FPS },
+    {   "benchmark",              required_argument,  NULL, OPT_BENCHMARK },
+    {   "sync-window",            required_argument,  NULL, OPT_SYNC_WINDOW },
+    {   "sync-wait",              required_argument,  NULL, OPT_SYNC_WAIT },
+
+    /* ...rendering options */
+    {   "async-upload",           no_argument,        NULL, OPT_ASYNC_UPLOAD },
+    {   "headless",               no_argument,        NULL, OPT_HEADLESS },
+    {   "frame-pacing",           no_argument,        NULL, OPT_FRAME_PACING },
+    {   "hud",                    no_argument,        NULL, OPT_HUD },
+    {   "yuv-convert",            no_argument,        NULL, OPT_YUV_CONVERT },
+    {   "mailbox",                no_argument,        NULL, OPT_MAILBOX },
+    {   "idle-fps",               required_argument,  NULL, OPT_IDLE_FPS },
+
     /* ...streaming options */
     {   "streaming-ip",           required_argument,  NULL, OPT_STREAMING_IP },
     {   "streaming-port",         required_argument,  NULL, OPT_STREAMING_PORT },
     {   "recording-filename",     required_argument,  NULL, OPT_RECORDING_FILENAME },
+    {   "event-preroll",          required_argument,  NULL, OPT_EVENT_PREROLL },
+    {   "event-postroll",         required_argument,  NULL, OPT_EVENT_POSTROLL },
+    {   "record-dir",             required_argument,  NULL, OPT_RECORD_DIR },
+    {   "record-segment",         required_argument,  NULL, OPT_RECORD_SEGMENT },
+    {   "record-segment-size",    required_argument,  NULL, OPT_RECORD_SEGMENT_SIZE },
+    {   "record-keep",            required_argument,  NULL, OPT_RECORD_KEEP },
+    {   "record-prealloc",        no_argument,        NULL, OPT_RECORD_PREALLOC },
+    {   "stream-dmabuf",          no_argument,        NULL, OPT_STREAM_DMABUF },
+    {   "stream-queue",           required_argument,  NULL, OPT_STREAM_QUEUE },
+    {   "stream-encoder",         required_argument,  NULL, OPT_STREAM_ENCODER },
+    {   "stream-budget",          required_argument,  NULL, OPT_STREAM_BUDGET },
+    {   "stream-feedback",        required_argument,  NULL, OPT_STREAM_FEEDBACK },
+    {   "control-socket",         required_argument,  NULL, OPT_CONTROL_SOCKET },
 
     {   NULL,               0,                  NULL, 0 },
 };
@@ -673,10 +859,45 @@ static void print_usage()
             "\t--view\t\t- orientation of window 0 - portrait, 1 - landscape\n"
             "\t--resolution\t- window size as WidthxHeight\n"
             "\t--camres\t- camera output size as WIDTHxHEIGHT\n"
+            "\nVIN capturing options:\n"
+            "\t--vin-threads\t - use dedicated capturing thread per V4L2 device\n"
+            "\t--vin-priority\t - SCHED_FIFO priority of capturing threads (0 - default policy)\n"
+            "\t--vin-affinity\t - CPU list for capturing threads: cpu1,cpu2,cpu3,cpu4\n"
+            "\t        \t  where -1 leaves thread unpinned\n"
+            "\t--vin-eventfd\t - use eventfd to wake up capturing threads on shutdown\n"
+            "\t--vin-buffers\t - number of buffers per V4L2 device, default 8\n"
+            "\t--vin-format\t - V4L2 capturing format (available options: uyvy, yuyv, nv12, nv16)\n"
+            "\t--vin-fps\t - V4L2 capturing frame rate (if supported by device)\n"
+            "\t--benchmark\t - report dequeue-to-render latency and drop rate every N seconds\n"
+            "\t--sync-window\t - max capture time difference between cameras in a rendered set, ms\n"
+            "\t        \t  (0 - always use newest frames, default)\n"
+            "\t--sync-wait\t - time to wait for a synchronized set before using best available, ms\n"
+            "\t        \t  (0 - use best available set immediately, default)\n"
+            "\nRendering options:\n"
+            "\t--async-upload\t - upload camera textures from a dedicated thread\n"
+            "\t--headless\t - render offscreen using surfaceless EGL platform (no compositor)\n"
+            "\t--frame-pacing\t - start rendering just in time for the predicted display refresh\n"
+            "\t--hud\t\t - show performance HUD on start (toggled with F12 key)\n"
+            "\t--yuv-convert\t - convert YUV camera buffers into RGB textures by a shader\n"
+            "\t--mailbox\t - render newest frames passed through lock-free mailboxes (excludes --sync-window/--sync-wait)\n"
+            "\t--idle-fps\t - rendering rate while paused (Pause key) or hidden, fps (default 2)\n"
             "\nStreaming options:\n"
             "\t--streaming-ip\t - host IP to stream\n"
             "\t--streaming-port\t - host base port to stream\n"
             "\t--recording-filename\t - name of mkv file to record video\n"
+            "\t--event-preroll\t - seconds of encoded video kept before event trigger (default 10, up to 60)\n"
+            "\t--event-postroll\t - seconds of encoded video recorded after event trigger (default 5, up to 60)\n"
+            "\t--record-dir\t - directory for recording files and segments (default current)\n"
+            "\t--record-segment\t - split recording into per-camera segments of N seconds\n"
+            "\t--record-segment-size\t - split recording into per-camera segments of N MB\n"
+            "\t--record-keep\t - number of segments kept per camera, oldest are deleted (0 - all)\n"
+            "\t--record-prealloc\t - preallocate segments and drop them from page cache once closed\n"
+            "\t--stream-dmabuf\t - pass captured buffers to VSP as DMA buffers (VIN cameras only)\n"
+            "\t--stream-queue\t - buffers queued for encoding per camera; newer are dropped (default 2)\n"
+            "\t--stream-encoder\t - H.264 encoder: auto, omx, x264 or openh264 (default auto)\n"
+            "\t--stream-budget\t - uplink budget of all cameras in kbit/s; enables adaptive bitrate\n"
+            "\t--stream-feedback\t - UDP port receiving \"<camera> <loss-percent>\" reports\n"
+            "\t--control-socket\t - unix SOCK_SEQPACKET socket for typed control requests\n"
             "\nAuxiliary calibration options:\n"
             "\t--intrinsicframes <mask1>,<mask2>,<mask3>,<mask4> - specify comma-separated\n"
             "\t         list of file masks which can be loaded in calibration UI\n"
@@ -912,6 +1133,101 @@ static int parse_cmdline(int argc, char **argv)
             __subtype = strtoul(optarg, NULL, 0);
 	    TRACE(INIT, _b("MJPEG camera settings: pdu subtype: 0x%x"), __subtype);
 	    break;
+        case OPT_VIN_THREADS:
+            TRACE (INIT, _b ("VIN per-device capturing threads ON"));
+            __vin_threads = 1;
+            break;
+
+        case OPT_VIN_PRIORITY:
+            __vin_priority = atoi(optarg);
+            TRACE (INIT, _b ("VIN capturing threads priority: %d"), __vin_priority);
+            break;
+
+        case OPT_VIN_AFFINITY:
+            TRACE (INIT, _b ("VIN capturing threads affinity: %s"), optarg);
+            CHK_API(parse_cpu_list(optarg, __vin_affinity, CAMERAS_NUMBER));
+            break;
+
+        case OPT_VIN_EVENTFD:
+            TRACE (INIT, _b ("VIN capturing threads eventfd shutdown ON"));
+            __vin_eventfd = 1;
+            break;
+
+        case OPT_VIN_BUFFERS:
+            __vin_buffers = atoi(optarg);
+            TRACE (INIT, _b ("VIN buffers number: %d"), __vin_buffers);
+            CHK_ERR(__vin_buffers >= 2 && __vin_buffers <= VIDEO_MAX_FRAME, -EINVAL);
+            break;
+
+        case OPT_VIN_FORMAT:
+            TRACE (INIT, _b ("VIN format: '%s'"), optarg);
+            CHK_ERR(__vin_format = parse_vin_format(optarg), -EINVAL);
+            break;
+
+        case OPT_VIN_FPS:
+            __vin_fps = atoi(optarg);
+            TRACE (INIT, _b ("VIN frame rate: %d"), __vin_fps);
+            break;
+
+        case OPT_BENCHMARK:
+            __benchmark_interval = atoi(optarg);
+            TRACE (INIT, _b ("Benchmark report interval: %d sec"), __benchmark_interval);
+            CHK_ERR(__benchmark_interval > 0, -EINVAL);
+            flags |= APP_FLAG_BENCHMARK;
+            break;
+
+        case OPT_SYNC_WINDOW:
+            __sync_window = atoi(optarg);
+            TRACE (INIT, _b ("Cameras synchronization window: %d ms"), __sync_window);
+            CHK_ERR(__sync_window >= 0, -EINVAL);
+            break;
+
+        case OPT_SYNC_WAIT:
+            __sync_wait = atoi(optarg);
+            TRACE (INIT, _b ("Cameras synchronization wait: %d ms"), __sync_wait);
+            CHK_ERR(__sync_wait >= 0, -EINVAL);
+            break;
+
+        case OPT_ASYNC_UPLOAD:
+            TRACE (INIT, _b ("Asynchronous texture upload enabled"));
+            __async_upload = 1;
+            break;
+
+        case OPT_HEADLESS:
+            TRACE (INIT, _b ("Headless rendering enabled"));
+            __display_headless = 1;
+            break;
+
+        case OPT_FRAME_PACING:
+            TRACE (INIT, _b ("Frame pacing enabled"));
+            __display_pacing = 1;
+            break;
+
+        case OPT_HUD:
+            TRACE (INIT, _b ("Performance HUD enabled"));
+            flags |= APP_FLAG_HUD;
+            break;
+
+        case OPT_YUV_CONVERT:
+#if defined (EGL_HAS_IMG_EXTERNAL_EXT)
+            TRACE (WARNING, _b ("YUV conversion is done by external images; option ignored"));
+#else
+            TRACE (INIT, _b ("Shader YUV conversion enabled"));
+            __display_yuv_convert = 1;
+#endif
+            break;
+
+        case OPT_MAILBOX:
+            TRACE (INIT, _b ("Mailbox frames exchange enabled"));
+            __render_mailbox = 1;
+            break;
+
+        case OPT_IDLE_FPS:
+            __idle_fps = atoi(optarg);
+            TRACE (INIT, _b ("Idle rendering rate: %d fps"), __idle_fps);
+            CHK_ERR(__idle_fps > 0, -EINVAL);
+            break;
+
         case OPT_STREAMING_IP:
             TRACE (INIT, _b ("Stream host IP: %s"), optarg);
             __stream_ip = optarg;
@@ -926,10 +1242,92 @@ static int parse_cmdline(int argc, char **argv)
             TRACE (INIT, _b ("Recording filename: %s"), optarg);
             __stream_file = optarg;
             break;
+
+        case OPT_EVENT_PREROLL:
+            __stream_event_pre = atoi(optarg);
+            TRACE (INIT, _b ("Event pre-roll: %d sec"), __stream_event_pre);
+            CHK_ERR(__stream_event_pre >= 0 && __stream_event_pre <= STREAM_EVENT_MAX, -EINVAL);
+            break;
+
+        case OPT_EVENT_POSTROLL:
+            __stream_event_post = atoi(optarg);
+            TRACE (INIT, _b ("Event post-roll: %d sec"), __stream_event_post);
+            CHK_ERR(__stream_event_post >= 0 && __stream_event_post <= STREAM_EVENT_MAX, -EINVAL);
+            break;
+
+        case OPT_RECORD_DIR:
+            TRACE (INIT, _b ("Recording directory: %s"), optarg);
+            __record_dir = optarg;
+            break;
+
+        case OPT_RECORD_SEGMENT:
+            __record_segment_time = atoi(optarg);
+            TRACE (INIT, _b ("Recording segment duration: %d sec"), __record_segment_time);
+            CHK_ERR(__record_segment_time >= 0, -EINVAL);
+            break;
+
+        case OPT_RECORD_SEGMENT_SIZE:
+            __record_segment_size = atoi(optarg);
+            TRACE (INIT, _b ("Recording segment size: %d MB"), __record_segment_size);
+            CHK_ERR(__record_segment_size >= 0, -EINVAL);
+            break;
+
+        case OPT_RECORD_KEEP:
+            __record_keep = atoi(optarg);
+            TRACE (INIT, _b ("Recording segments kept: %d"), __record_keep);
+            CHK_ERR(__record_keep >= 0, -EINVAL);
+            break;
+
+        case OPT_RECORD_PREALLOC:
+            TRACE (INIT, _b ("Recording segments preallocation enabled"));
+            __record_prealloc = 1;
+            break;
+
+        case OPT_STREAM_DMABUF:
+            TRACE (INIT, _b ("DMA buffers hand-off to streaming pipelines enabled"));
+            __stream_dmabuf = 1;
+            break;
+
+        case OPT_STREAM_QUEUE:
+            __stream_queue = atoi(optarg);
+            TRACE (INIT, _b ("Encoder queue length: %d"), __stream_queue);
+            CHK_ERR(__stream_queue > 0, -EINVAL);
+            break;
+
+        case OPT_STREAM_ENCODER:
+            TRACE (INIT, _b ("Streaming encoder: '%s'"), optarg);
+            __stream_encoder = optarg;
+            break;
+
+        case OPT_STREAM_BUDGET:
+            __stream_budget = atoi(optarg);
+            TRACE (INIT, _b ("Streaming uplink budget: %d kbit/s"), __stream_budget);
+            CHK_ERR(__stream_budget > 0, -EINVAL);
+            break;
+
+        case OPT_STREAM_FEEDBACK:
+            __stream_feedback_port = atoi(optarg);
+            TRACE (INIT, _b ("Streaming feedback port: %d"), __stream_feedback_port);
+            CHK_ERR(__stream_feedback_port > 0 && __stream_feedback_port < 65536, -EINVAL);
+            break;
+
+        case OPT_CONTROL_SOCKET:
+            TRACE (INIT, _b ("Control socket: '%s'"), optarg);
+            __stream_control_socket = optarg;
+            break;
+
         default:
         return -EINVAL;
         }
     }
+
+    /* ...mailboxes always render newest frames; synchronized set selection is not applicable */
+    if (__render_mailbox && (__sync_window || __sync_wait))
+    {
+        TRACE(ERROR, _b("--mailbox cannot be combined with --sync-window/--sync-wait"));
+        return -EINVAL;
+    }
+
     /* ...check we have found both live tracks */
     if (iface)
     {
@@ -951,7 +1349,7 @@ static int parse_cmdline(int argc, char **argv)
         CHK_ERR(__sv_live = track_create(NULL, 0), -(errno = ENOMEM));
         __sv_live->camera_cfg = __sv_cfg.config_path;
         vin_addresses_to_name(__sv_live->camera_names, vin_devices);
-        __sv_live->pixformat = GST_VIDEO_FORMAT_UYVY;
+        __sv_live->pixformat = __vin_format;
         __sv_live->camera_type = TRACK_CAMERA_TYPE_VIN;
         flags |= APP_FLAG_SVIEW;
         flags |= APP_FLAG_LIVE;
@@ -1128,6 +1526,9 @@ int app_track_start(app_data_t *app, track_desc_t *track, int start)
 {
     /* ...initialize active cameras set (not always required) */
 
+    /* ...only VIN capturing buffers can be handed off to VSP as DMA buffers */
+    app->track_dmabuf = (track == __sv_live && track->camera_type == TRACK_CAMERA_TYPE_VIN);
+
     /* ...current played file? - tbd */
     if (track == __sv_live)
     {
@@ -1165,6 +1566,9 @@ int main(int argc, char **argv)
     /* ...initialize tracer facility */
     TRACE_INIT("Surround View Application: " SV_VERSION_STRING);
 
+    /* ...calibrate performance counters before any thread gets measured */
+    PM_INIT();
+
     /* ...initialize GStreamer */
     gst_init(&argc, &argv);
 
@@ -42,6 +42,9 @@
 /* ...enable performance monitor counters collection */
 #define SV_PM                       1
 
+/* ...take performance monitor stamps from raw CPU counter */
+#define SV_PM_CYCLES                0
+
 /*******************************************************************************
  * Includes
  ******************************************************************************/
@@ -0,0 +1,457 @@
+/*******************************************************************************
+ *
+ * Text overlay rendering from a glyph atlas
+ *
+ * Copyright (c) 2017 Cogent Embedded Inc. ALL RIGHTS RESERVED.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#define MODULE_TAG                      OVERLAY
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdarg.h>
+
+#include "main.h"
+#include "common.h"
+#include "display-wayland.h"
+#include "overlay.h"
+
+/*******************************************************************************
+ * Tracing configuration
+ ******************************************************************************/
+
+TRACE_TAG(INIT, 1);
+TRACE_TAG(DEBUG, 1);
+
+/*******************************************************************************
+ * Local constants definitions
+ ******************************************************************************/
+
+/* ...printable ASCII characters range kept in atlas */
+#define OVERLAY_FIRST_CHAR              32
+#define OVERLAY_LAST_CHAR               126
+#define OVERLAY_CHARS_NUMBER            (OVERLAY_LAST_CHAR - OVERLAY_FIRST_CHAR + 1)
+
+/* ...atlas layout (number of glyph cells in a row) */
+#define OVERLAY_ATLAS_COLUMNS           16
+
+/* ...maximal number of characters drawn in a single batch */
+#define OVERLAY_MAX_CHARS               2048
+
+/* ...vertex data: position (x, y) and texture coordinates (u, v) */
+#define OVERLAY_VERTEX_SIZE             4
+
+/*******************************************************************************
+ * Local typedefs
+ ******************************************************************************/
+
+struct overlay
+{
+    /* ...glyph atlas texture */
+    GLuint              atlas;
+
+    /* ...atlas texture dimensions */
+    int                 atlas_width, atlas_height;
+
+    /* ...glyph cell dimensions (monospace font) */
+    int                 cell_width, cell_height;
+
+    /* ...shader program and its bindings */
+    GLuint              program;
+    GLint               a_vertex;
+    GLint               u_color;
+    GLint               u_atlas;
+
+    /* ...vertex buffer object */
+    GLuint              vbo;
+
+    /* ...vertex data staging area */
+    GLfloat             vertex[OVERLAY_MAX_CHARS * 6 * OVERLAY_VERTEX_SIZE];
+
+    /* ...area covered by last drawn text (x, y, w, h; bottom-left origin) */
+    int                 bounds[4];
+};
+
+/*******************************************************************************
+ * Shaders
+ ******************************************************************************/
+
+static const char *__overlay_vs =
+    "attribute vec4 a_vertex;\n"
+    "varying vec2 v_uv;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(a_vertex.xy, 0.0, 1.0);\n"
+    "    v_uv = a_vertex.zw;\n"
+    "}\n";
+
+static const char *__overlay_fs =
+    "precision mediump float;\n"
+    "varying vec2 v_uv;\n"
+    "uniform sampler2D u_atlas;\n"
+    "uniform vec4 u_color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(u_color.rgb, u_color.a * texture2D(u_atlas, v_uv).a);\n"
+    "}\n";
+
+/* ...compile single shader */
+static GLuint overlay_shader(GLenum type, const char *text)
+{
+    GLuint  shader = glCreateShader(type);
+    GLint   status;
+    char    log[256];
+
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+    if (!status)
+    {
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        TRACE(ERROR, _x("shader compilation failed: %s"), log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/* ...create overlay shader program */
+static int overlay_program(overlay_t *overlay)
+{
+    GLuint  vs, fs, program;
+    GLint   status;
+
+    CHK_ERR(vs = overlay_shader(GL_VERTEX_SHADER, __overlay_vs), -EINVAL);
+
+    if ((fs = overlay_shader(GL_FRAGMENT_SHADER, __overlay_fs)) == 0)
+    {
+        glDeleteShader(vs);
+        return -EINVAL;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+    /* ...shaders are kept by program */
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    if (!status)
+    {
+        TRACE(ERROR, _x("program linking failed"));
+        glDeleteProgram(program);
+        return -EINVAL;
+    }
+
+    overlay->program = program;
+    overlay->a_vertex = glGetAttribLocation(program, "a_vertex");
+    overlay->u_color = glGetUniformLocation(program, "u_color");
+    overlay->u_atlas = glGetUniformLocation(program, "u_atlas");
+
+    return 0;
+}
+
+/*******************************************************************************
+ * Glyph atlas
+ ******************************************************************************/
+
+/* ...render printable characters into alpha-only texture */
+static int overlay_atlas(overlay_t *overlay, int size)
+{
+    cairo_surface_t        *cs;
+    cairo_t                *cr;
+    cairo_font_extents_t    fe;
+    int                     rows = (OVERLAY_CHARS_NUMBER + OVERLAY_ATLAS_COLUMNS - 1) / OVERLAY_ATLAS_COLUMNS;
+    int                     i;
+    char                    c[2] = { 0, 0 };
+
+    /* ...measure font using scratch surface */
+    cs = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+    cr = cairo_create(cs);
+    cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, size);
+    cairo_font_extents(cr, &fe);
+    cairo_destroy(cr);
+    cairo_surface_destroy(cs);
+
+    overlay->cell_width = (int)ceil(fe.max_x_advance);
+    overlay->cell_height = (int)ceil(fe.ascent + fe.descent);
+
+    /* ...render glyphs into cells */
+    cs = cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                    overlay->cell_width * OVERLAY_ATLAS_COLUMNS,
+                                    overlay->cell_height * rows);
+    CHK_ERR(__check_surface(cs) == 0, -ENOMEM);
+
+    cr = cairo_create(cs);
+    cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, size);
+    cairo_set_source_rgba(cr, 1, 1, 1, 1);
+
+    for (i = 0; i < OVERLAY_CHARS_NUMBER; i++)
+    {
+        c[0] = (char)(OVERLAY_FIRST_CHAR + i);
+        cairo_move_to(cr,
+                      (i % OVERLAY_ATLAS_COLUMNS) * overlay->cell_width,
+                      (i / OVERLAY_ATLAS_COLUMNS) * overlay->cell_height + fe.ascent);
+        cairo_show_text(cr, c);
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_flush(cs);
+
+    /* ...texture width is a surface stride (rows are 4-bytes aligned) */
+    overlay->atlas_width = cairo_image_surface_get_stride(cs);
+    overlay->atlas_height = cairo_image_surface_get_height(cs);
+
+    glGenTextures(1, &overlay->atlas);
+    glBindTexture(GL_TEXTURE_2D, overlay->atlas);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_ALPHA,
+                 overlay->atlas_width,
+                 overlay->atlas_height,
+                 0,
+                 GL_ALPHA,
+                 GL_UNSIGNED_BYTE,
+                 cairo_image_surface_get_data(cs));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    cairo_surface_destroy(cs);
+
+    TRACE(INIT, _b("glyph atlas %d*%d created (cell: %d*%d)"),
+          overlay->atlas_width, overlay->atlas_height, overlay->cell_width, overlay->cell_height);
+
+    return 0;
+}
+
+/*******************************************************************************
+ * Entry points
+ ******************************************************************************/
+
+/* ...create overlay with glyph atlas for a given font size (in pixels) */
+overlay_t * overlay_create(int size)
+{
+    overlay_t  *overlay;
+
+    CHK_ERR(overlay = calloc(1, sizeof(*overlay)), (errno = ENOMEM, NULL));
+
+    if (overlay_program(overlay) < 0)
+    {
+        goto error;
+    }
+
+    if (overlay_atlas(overlay, size) < 0)
+    {
+        goto error_program;
+    }
+
+    glGenBuffers(1, &overlay->vbo);
+
+    return overlay;
+
+error_program:
+    glDeleteProgram(overlay->program);
+
+error:
+    free(overlay);
+    errno = EINVAL;
+    return NULL;
+}
+
+/* ...add transformed vertex in normalized device coordinates */
+static inline GLfloat * overlay_vertex(GLfloat *v, const cairo_matrix_t *m, int w, int h, float x, float y, float u, float t)
+{
+    double  X = x, Y = y;
+
+    cairo_matrix_transform_point(m, &X, &Y);
+
+    *v++ = (GLfloat)(2.0 * X / w - 1.0);
+    *v++ = (GLfloat)(1.0 - 2.0 * Y / h);
+    *v++ = u;
+    *v++ = t;
+
+    return v;
+}
+
+/* ...compute window area covered by vertices staged so far */
+static void overlay_update_bounds(overlay_t *overlay, const GLfloat *end, int w, int h)
+{
+    const GLfloat  *v = overlay->vertex;
+    float           x0 = 1, y0 = 1, x1 = -1, y1 = -1;
+
+    for (; v < end; v += OVERLAY_VERTEX_SIZE)
+    {
+        x0 = MIN(x0, v[0]), x1 = MAX(x1, v[0]);
+        y0 = MIN(y0, v[1]), y1 = MAX(y1, v[1]);
+    }
+
+    if (x0 > x1)
+    {
+        memset(overlay->bounds, 0, sizeof(overlay->bounds));
+        return;
+    }
+
+    /* ...normalized device coordinates have bottom-left origin as EGL damage rectangles */
+    overlay->bounds[0] = (int)floor((x0 + 1) * w / 2);
+    overlay->bounds[1] = (int)floor((y0 + 1) * h / 2);
+    overlay->bounds[2] = (int)ceil((x1 + 1) * w / 2) - overlay->bounds[0];
+    overlay->bounds[3] = (int)ceil((y1 + 1) * h / 2) - overlay->bounds[1];
+}
+
+/* ...draw multi-line text at window position (top-left corner of first line) */
+void overlay_draw(overlay_t *overlay,
+                  window_data_t *window,
+                  int x,
+                  int y,
+                  const float *color,
+                  const char *fmt, ...)
+{
+    const cairo_matrix_t   *m = window_get_cmatrix(window);
+    int                     w = window_get_width(window);
+    int                     h = window_get_height(window);
+    float                   cw = overlay->cell_width, ch = overlay->cell_height;
+    float                   aw = overlay->atlas_width, ah = overlay->atlas_height;
+    char                    text[OVERLAY_MAX_CHARS + 1], *p;
+    GLfloat                *v = overlay->vertex;
+    GLboolean               blend, depth, cull;
+    GLint                   vao = 0, vbo, tex, unit, prog;
+    float                   X = x, Y = y;
+    int                     n;
+    va_list                 argp;
+
+    va_start(argp, fmt);
+    vsnprintf(text, sizeof(text), fmt, argp);
+    va_end(argp);
+
+    /* ...build vertex data for all characters */
+    for (p = text, n = 0; *p; p++)
+    {
+        int     i = (unsigned char)*p;
+        float   u, t;
+
+        if (i == '\n')
+        {
+            X = x, Y += ch;
+            continue;
+        }
+
+        /* ...replace characters missing in atlas */
+        (i < OVERLAY_FIRST_CHAR || i > OVERLAY_LAST_CHAR ? i = '?' : 0);
+        i -= OVERLAY_FIRST_CHAR;
+
+        u = (i % OVERLAY_ATLAS_COLUMNS) * cw;
+        t = (i / OVERLAY_ATLAS_COLUMNS) * ch;
+
+        /* ...two triangles per glyph */
+        v = overlay_vertex(v, m, w, h, X, Y, u / aw, t / ah);
+        v = overlay_vertex(v, m, w, h, X + cw, Y, (u + cw) / aw, t / ah);
+        v = overlay_vertex(v, m, w, h, X, Y + ch, u / aw, (t + ch) / ah);
+        v = overlay_vertex(v, m, w, h, X + cw, Y, (u + cw) / aw, t / ah);
+        v = overlay_vertex(v, m, w, h, X + cw, Y + ch, (u + cw) / aw, (t + ch) / ah);
+        v = overlay_vertex(v, m, w, h, X, Y + ch, u / aw, (t + ch) / ah);
+
+        X += cw, n++;
+    }
+
+    /* ...track covered area for damage reporting */
+    overlay_update_bounds(overlay, v, w, h);
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    /* ...save state we are going to change */
+    blend = glIsEnabled(GL_BLEND);
+    depth = glIsEnabled(GL_DEPTH_TEST);
+    cull = glIsEnabled(GL_CULL_FACE);
+    (glBindVertexArrayOES ? glGetIntegerv(GL_VERTEX_ARRAY_BINDING_OES, &vao) : (void)0);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &vbo);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex);
+
+    /* ...vertex attributes must not go into engine's vertex array object */
+    (glBindVertexArrayOES ? glBindVertexArrayOES(0) : (void)0);
+
+    glViewport(0, 0, w, h);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(overlay->program);
+    glBindTexture(GL_TEXTURE_2D, overlay->atlas);
+    glUniform1i(overlay->u_atlas, 0);
+    glUniform4fv(overlay->u_color, 1, color);
+
+    /* ...single batch for the whole text */
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (v - overlay->vertex) * sizeof(GLfloat), overlay->vertex, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(overlay->a_vertex);
+    glVertexAttribPointer(overlay->a_vertex, OVERLAY_VERTEX_SIZE, GL_FLOAT, GL_FALSE, 0, NULL);
+    glDrawArrays(GL_TRIANGLES, 0, n * 6);
+    glDisableVertexAttribArray(overlay->a_vertex);
+
+    /* ...restore state */
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glActiveTexture(unit);
+    glUseProgram(prog);
+    (glBindVertexArrayOES ? glBindVertexArrayOES(vao) : (void)0);
+    (blend ? (void)0 : glDisable(GL_BLEND));
+    (depth ? glEnable(GL_DEPTH_TEST) : (void)0);
+    (cull ? glEnable(GL_CULL_FACE) : (void)0);
+
+    TRACE(DEBUG, _b("overlay: %d characters drawn"), n);
+}
+
+/* ...get area covered by last drawn text; returns 0 if nothing has been drawn */
+int overlay_bounds(overlay_t *overlay, int *rect)
+{
+    memcpy(rect, overlay->bounds, sizeof(overlay->bounds));
+
+    return (rect[2] > 0 && rect[3] > 0);
+}
+
+/* ...destroy overlay data */
+void overlay_destroy(overlay_t *overlay)
+{
+    glDeleteBuffers(1, &overlay->vbo);
+    glDeleteTextures(1, &overlay->atlas);
+    glDeleteProgram(overlay->program);
+    free(overlay);
+}
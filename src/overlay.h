@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ * Text overlay rendering from a glyph atlas
+ *
+ * Copyright (c) 2017 Cogent Embedded Inc. ALL RIGHTS RESERVED.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SV_SURROUNDVIEW_OVERLAY_H
+#define SV_SURROUNDVIEW_OVERLAY_H
+
+#include "display.h"
+
+/*******************************************************************************
+ * Types definitions
+ ******************************************************************************/
+
+/* ...opaque overlay handle */
+typedef struct overlay      overlay_t;
+
+/*******************************************************************************
+ * Entry points (must be called with a window GL context current)
+ ******************************************************************************/
+
+/* ...create overlay with glyph atlas for a given font size (in pixels) */
+extern overlay_t * overlay_create(int size);
+
+/* ...draw multi-line text at window position (top-left corner of first line) */
+extern void overlay_draw(overlay_t *overlay,
+                         window_data_t *window,
+                         int x,
+                         int y,
+                         const float *color,
+                         const char *fmt, ...);
+
+/* ...get area covered by last drawn text (x, y, w, h; bottom-left origin) */
+extern int overlay_bounds(overlay_t *overlay, int *rect);
+
+/* ...destroy overlay data */
+extern void overlay_destroy(overlay_t *overlay);
+
+#endif  /* SV_SURROUNDVIEW_OVERLAY_H */
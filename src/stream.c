@@ -39,15 +39,28 @@
 
 #include <glib.h>
 #include <gst/gst.h>
+#include <gio/gio.h>
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <linux/sockios.h>
 
 #include <string.h>
 #include <gstreamer-1.0/gst/app/gstappsrc.h>
+#include <gstreamer-1.0/gst/app/gstappsink.h>
+#include <gst/allocators/gstdmabuf.h>
 #include <mqueue.h>
 
 #include <linux/media.h>
@@ -80,290 +93,2007 @@ char* vsp_devices[2 * VSP_DEVICE_NUMBER];
 #define STREAM_CONTROL_MQ "/svcontrolmq"
 #define RECORDING_FILENAME "test.mkv"
 
-#define STREAMING_PIPELINE "appsrc name=stream_src_%d ! " \
-    "video/x-raw,width=%d,format=UYVY,framerate=30/1,height=%d ! " \
-    "vspfilter devfile-input=%s devfile-output=%s input-io-mode=userptr ! queue ! " \
-    "video/x-raw,format=NV12 !" \
+/* ...encoder target bitrate and frame rate (as set in pipelines below) */
+#define STREAM_BITRATE                  4000000
+#define STREAM_FRAMERATE                30
+
+/* ...camera input of each branch (format conversion and encoding follow) */
+#define PIPELINE_SOURCE "appsrc name=stream_src_%d ! " \
+    "video/x-raw,width=%d,format=UYVY,framerate=30/1,height=%d ! "
+
+#define STREAMING_PIPELINE PIPELINE_SOURCE "%s ! %s ! udpsink name=stream_udp_%d host=%s port=%d sync=false "
+
+#define RECORDING_PIPELINE PIPELINE_SOURCE "%s ! h264parse ! %s "
+
+#define PIPELINE_FILESINK " matroskamux name=mux ! filesink location=%s "
+
+/* ...per-camera segmented recording (cuts are keyframe-aligned) */
+#define PIPELINE_SEGMENTSINK " splitmuxsink name=mux_%d muxer=matroskamux " \
+    "location=%s/%s-%d-%%05d.mkv max-size-time=%" G_GUINT64_FORMAT " " \
+    "max-size-bytes=%" G_GUINT64_FORMAT " max-files=%d send-keyframe-requests=%s "
+
+#define COMBINED_PIPELINE PIPELINE_SOURCE "%s ! tee name=t_%d " \
+    "t_%d.src_0 ! queue ! h264parse ! %s "\
+    "t_%d.src_1 ! queue ! %s ! " \
+    "udpsink name=stream_udp_%d host=%s port=%d sync=false "
+
+#define EVENT_PIPELINE PIPELINE_SOURCE "%s ! h264parse config-interval=-1 ! " \
+    "video/x-h264,stream-format=byte-stream,alignment=au ! " \
+    "appsink name=event_sink_%d sync=false "
+
+/*******************************************************************************
+ * Encoder back-ends
+ ******************************************************************************/
+
+/* ...VSP format conversion and OMX encoder (VSP input and output devices) */
+#define ENCODER_OMX "vspfilter devfile-input=%s devfile-output=%s input-io-mode=userptr ! queue ! " \
+    "video/x-raw,format=NV12 ! " \
     "omxh264enc use-dmabuf=true num-p-frames=29 control-rate=2 " \
-    "target-bitrate=4000000 ! ieee1722pay ! udpsink host=%s port=%d sync=false "
+    "target-bitrate=4000000 ! video/x-h264,profile=high"
+
+/* ...software conversion and encoding for hosts without R-Car multimedia; chain runs
+ * in appsrc streaming thread so that camera buffers are bounded by appsrc queue */
+#define ENCODER_X264 "videoconvert ! video/x-raw,format=I420 ! " \
+    "x264enc tune=zerolatency speed-preset=ultrafast bitrate=4000 key-int-max=30 ! " \
+    "video/x-h264,profile=high"
+
+#define ENCODER_OPENH264 "videoconvert ! video/x-raw,format=I420 ! " \
+    "openh264enc bitrate=4000000 gop-size=30 ! video/x-h264"
+
+/* ...encoder back-end descriptor */
+typedef struct stream_backend
+{
+    /* ...back-end name (command-line option value) */
+    const char         *name;
+
+    /* ...elements that must be available */
+    const char         *elements[2];
+
+    /* ...branch encoder description */
+    const char         *encoder;
+
+    /* ...VSP devices are used */
+    int                 vsp;
+
+    /* ...encoder bitrate property and its unit (bit/s) */
+    const char         *bitrate;
+    int                 unit;
+
+}   stream_backend_t;
+
+/* ...back-ends in order of preference */
+static const stream_backend_t __stream_backends[] = {
+    { "omx", { "vspfilter", "omxh264enc" }, ENCODER_OMX, 1, "target-bitrate", 1 },
+    { "x264", { "videoconvert", "x264enc" }, ENCODER_X264, 0, "bitrate", 1000 },
+    { "openh264", { "videoconvert", "openh264enc" }, ENCODER_OPENH264, 0, "bitrate", 1 },
+};
+
+/* ...selected back-end */
+static const stream_backend_t  *__stream_backend;
+
+/* ...network payloader (AVTP if available) */
+static const char              *__stream_payloader;
+
+/* ...check if all elements of a back-end are registered */
+static int stream_backend_available(const stream_backend_t *b)
+{
+    GstElementFactory  *f;
+    int                 i;
+
+    for (i = 0; i < 2; i++)
+    {
+        if ((f = gst_element_factory_find(b->elements[i])) == NULL)
+        {
+            return 0;
+        }
+
+        gst_object_unref(f);
+    }
+
+    return 1;
+}
+
+/* ...select encoder back-end ("auto" takes first available) */
+static const stream_backend_t * stream_backend_select(const char *name)
+{
+    const stream_backend_t *b;
+    GstElementFactory      *f;
+
+    for (b = __stream_backends; b < __stream_backends + sizeof(__stream_backends) / sizeof(*b); b++)
+    {
+        if (strcmp(name, "auto") && strcmp(name, b->name))
+        {
+            continue;
+        }
+
+        if (stream_backend_available(b))
+        {
+            break;
+        }
+
+        TRACE(ERROR, _b("stream: encoder '%s' is not available"), b->name);
+    }
+
+    CHK_ERR(b < __stream_backends + sizeof(__stream_backends) / sizeof(*b), (errno = ENOENT, NULL));
+
+    /* ...RTP is used where AVTP payloader is missing */
+    if ((f = gst_element_factory_find("ieee1722pay")) != NULL)
+    {
+        __stream_payloader = "ieee1722pay", gst_object_unref(f);
+    }
+    else
+    {
+        __stream_payloader = "rtph264pay config-interval=-1 pt=96";
+    }
+
+    TRACE(INIT, _b("stream: encoder '%s', payloader '%s'"), b->name, __stream_payloader);
+
+    return b;
+}
+
+/*******************************************************************************
+ * Event recording (ring of encoded frames)
+ ******************************************************************************/
+
+/* ...extra ring capacity covering keyframe interval and bitrate overshoot (seconds) */
+#define EVENT_MARGIN                    2
+
+/* ...event segment file name (trigger time and camera index) */
+#define EVENT_FILENAME                  "event-%s-%d.h264"
+
+/* ...encoded access unit descriptor */
+typedef struct event_frame
+{
+    /* ...position of frame data in the ring */
+    u32                 offset, size;
+
+    /* ...arrival time at encoder output (monotonic, usec); trails capture by encoder
+     * latency, so pre-roll effectively starts that much earlier than requested */
+    gint64              ts;
+
+    /* ...frame starts a GOP */
+    int                 key;
+
+}   event_frame_t;
+
+/* ...per-camera ring of encoded frames (storage is allocated once) */
+typedef struct event_ring
+{
+    /* ...ring access lock */
+    pthread_mutex_t     lock;
+
+    /* ...frames data storage */
+    u8                 *data;
+
+    /* ...storage capacity and write position */
+    u32                 size, head;
+
+    /* ...frame descriptors ring */
+    event_frame_t      *frame;
+
+    /* ...descriptors capacity, oldest descriptor index and number of frames held */
+    u32                 frames, first, num;
+
+    /* ...ring is being written to a file; new frames are dropped */
+    int                 frozen;
+
+    /* ...waiting for a keyframe after a gap */
+    int                 sync;
+
+    /* ...frames dropped while frozen */
+    u32                 dropped;
+
+}   event_ring_t;
+
+/* ...event recorder data */
+struct event_recorder
+{
+    /* ...per-camera rings */
+    event_ring_t        ring[CAMERAS_NUMBER];
+
+    /* ...segment writer thread */
+    pthread_t           thread;
+
+    /* ...trigger access lock and writer wakeup condition */
+    pthread_mutex_t     lock;
+    pthread_cond_t      wait;
+
+    /* ...pending trigger time (monotonic, usec; 0 - none) */
+    gint64              trigger;
+
+    /* ...segments destination directory */
+    char               *dir;
+
+    /* ...writer termination request */
+    int                 exit;
+};
+
+/* ...reserve ring space for a frame, evicting oldest frames */
+static u32 event_ring_reserve(event_ring_t *ring, u32 size)
+{
+    int             wrap = (ring->head + size > ring->size);
+    u32             pos = (wrap ? 0 : ring->head);
+    event_frame_t  *f;
+
+    while (ring->num)
+    {
+        f = &ring->frame[ring->first];
+
+        /* ...frames of previous lap are behind the head; drop them all on wrap-around */
+        if (ring->num < ring->frames && !(wrap && f->offset >= ring->head) &&
+            (f->offset >= pos + size || f->offset + f->size <= pos))
+        {
+            break;
+        }
+
+        ring->first = (ring->first + 1) % ring->frames, ring->num--;
+    }
+
+    return pos;
+}
+
+/* ...put encoded frame into a ring */
+static void event_ring_push(event_ring_t *ring, const u8 *data, u32 size, int key)
+{
+    event_frame_t  *f;
+    u32             pos;
+
+    pthread_mutex_lock(&ring->lock);
+
+    /* ...frames passed while ring is written out cannot be decoded; resume from keyframe */
+    if (ring->frozen || (ring->sync && !key) || size > ring->size)
+    {
+        ring->dropped++, ring->sync = 1;
+        pthread_mutex_unlock(&ring->lock);
+        return;
+    }
+
+    pos = event_ring_reserve(ring, size);
+    f = &ring->frame[(ring->first + ring->num++) % ring->frames];
+    f->offset = pos, f->size = size, f->ts = g_get_monotonic_time(), f->key = key;
+    memcpy(ring->data + pos, data, size);
+    ring->head = pos + size, ring->sync = 0;
+
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/* ...encoded frame retrieval callback (encoder streaming thread) */
+static GstFlowReturn event_sink_sample(GstAppSink *sink, gpointer user_data)
+{
+    event_ring_t   *ring = user_data;
+    GstSample      *sample;
+    GstBuffer      *buffer;
+    GstMapInfo      map;
+
+    if ((sample = gst_app_sink_pull_sample(sink)) == NULL)
+    {
+        return GST_FLOW_EOS;
+    }
+
+    buffer = gst_sample_get_buffer(sample);
+
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ))
+    {
+        event_ring_push(ring, map.data, map.size, !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+        gst_buffer_unmap(buffer, &map);
+    }
+
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+static GstAppSinkCallbacks event_sink_callbacks = {
+    .new_sample = event_sink_sample,
+};
+
+/* ...write buffer to a file completely */
+static int event_write(int fd, const u8 *data, u32 size)
+{
+    ssize_t     n;
+
+    for (; size; data += n, size -= n)
+    {
+        if ((n = write(fd, data, size)) < 0 && errno != EINTR)
+        {
+            return -errno;
+        }
+
+        n = MAX(n, 0);
+    }
+
+    return 0;
+}
+
+/* ...write frames of a ring starting from keyframe preceding given time */
+static void event_ring_dump(event_ring_t *ring, int fd, gint64 from)
+{
+    event_frame_t  *f;
+    int             start = -1;
+    u32             k, n = 0, bytes = 0;
+
+    /* ...ring content is stable while frozen; encoder thread drops frames meanwhile */
+    pthread_mutex_lock(&ring->lock);
+    ring->frozen = 1;
+    pthread_mutex_unlock(&ring->lock);
+
+    for (k = 0; k < ring->num; k++)
+    {
+        f = &ring->frame[(ring->first + k) % ring->frames];
+
+        if (f->key && (start < 0 || f->ts <= from))
+        {
+            start = k;
+        }
+    }
+
+    for (k = start; start >= 0 && k < ring->num; k++, n++)
+    {
+        f = &ring->frame[(ring->first + k) % ring->frames];
+
+        if (event_write(fd, ring->data + f->offset, f->size) < 0)
+        {
+            TRACE(ERROR, _x("event segment write failed: %m"));
+            break;
+        }
+
+        bytes += f->size;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    ring->frozen = 0;
+    TRACE(INFO, _b("event: %u frames (%u bytes) written, %u frames dropped"), n, bytes, ring->dropped);
+    ring->dropped = 0;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/* ...write event segment of all cameras */
+static void event_recorder_dump(event_recorder_t *rec, gint64 trigger)
+{
+    gint64      from = trigger - (gint64)__stream_event_pre * 1000000;
+    char        ts[32], name[64], *path;
+    time_t      now = time(NULL);
+    struct tm   tm;
+    int         i, fd;
+
+    strftime(ts, sizeof(ts), "%Y%m%d-%H%M%S", localtime_r(&now, &tm));
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        snprintf(name, sizeof(name), EVENT_FILENAME, ts, i);
+        path = g_build_filename(rec->dir, name, NULL);
+
+        if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        {
+            TRACE(ERROR, _x("failed to create event segment '%s': %m"), path);
+            g_free(path);
+            continue;
+        }
+
+        event_ring_dump(&rec->ring[i], fd, from);
+        close(fd);
+
+        TRACE(INFO, _b("event segment '%s' saved"), path);
+        g_free(path);
+    }
+}
+
+/* ...segment writer thread */
+static void * event_recorder_thread(void *arg)
+{
+    event_recorder_t   *rec = arg;
+    struct timespec     abstime;
+    gint64              trigger, deadline;
+
+    pthread_mutex_lock(&rec->lock);
+
+    while (!rec->exit || rec->trigger)
+    {
+        if (rec->trigger == 0)
+        {
+            pthread_cond_wait(&rec->wait, &rec->lock);
+            continue;
+        }
+
+        /* ...collect post-roll unless pipeline is being torn down */
+        deadline = rec->trigger + (gint64)__stream_event_post * 1000000;
+
+        if (!rec->exit && g_get_monotonic_time() < deadline)
+        {
+            abstime.tv_sec = deadline / 1000000;
+            abstime.tv_nsec = (deadline % 1000000) * 1000;
+            pthread_cond_timedwait(&rec->wait, &rec->lock, &abstime);
+            continue;
+        }
+
+        trigger = rec->trigger;
+        pthread_mutex_unlock(&rec->lock);
+
+        event_recorder_dump(rec, trigger);
+
+        pthread_mutex_lock(&rec->lock);
+        rec->trigger = 0;
+    }
+
+    pthread_mutex_unlock(&rec->lock);
+
+    return NULL;
+}
+
+/* ...request event segment recording */
+static void event_recorder_trigger(event_recorder_t *rec)
+{
+    pthread_mutex_lock(&rec->lock);
+
+    /* ...event close to a pending one is covered by its post-roll */
+    if (rec->trigger == 0)
+    {
+        rec->trigger = g_get_monotonic_time();
+        pthread_cond_signal(&rec->wait);
+        TRACE(INFO, _b("event triggered"));
+    }
+    else
+    {
+        TRACE(INFO, _b("event is being recorded already"));
+    }
+
+    pthread_mutex_unlock(&rec->lock);
+}
+
+/* ...destroy recorder (pipeline must be stopped); pending segment is written */
+static void event_recorder_destroy(event_recorder_t *rec)
+{
+    int     i;
+
+    pthread_mutex_lock(&rec->lock);
+    rec->exit = 1;
+    pthread_cond_signal(&rec->wait);
+    pthread_mutex_unlock(&rec->lock);
+
+    pthread_join(rec->thread, NULL);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        pthread_mutex_destroy(&rec->ring[i].lock);
+        free(rec->ring[i].data);
+        free(rec->ring[i].frame);
+    }
+
+    pthread_cond_destroy(&rec->wait);
+    pthread_mutex_destroy(&rec->lock);
+    g_free(rec->dir);
+    free(rec);
+}
+
+/* ...create recorder attached to encoders output of a pipeline */
+static event_recorder_t * event_recorder_create(app_data_t *app, GstPipeline *pipeline)
+{
+    int                 seconds = __stream_event_pre + __stream_event_post + EVENT_MARGIN;
+    event_recorder_t   *rec;
+    pthread_condattr_t  attr;
+    GstElement         *sink;
+    size_t              size = (size_t)STREAM_BITRATE / 8 * seconds;
+    char                name[16], *path;
+    int                 i, r;
+
+    /* ...intervals are bounded by command line parsing; make sure ring offsets fit anyway */
+    CHK_ERR(seconds > 0 && size / seconds == (size_t)STREAM_BITRATE / 8 && size <= G_MAXUINT32, (errno = EINVAL, NULL));
+
+    CHK_ERR(rec = calloc(1, sizeof(*rec)), (errno = ENOMEM, NULL));
+
+    /* ...segments go next to recordings (file name may be changed via control channel) */
+    path = (g_path_is_absolute(app->stream_file) ? g_strdup(app->stream_file) : g_build_filename(__record_dir, app->stream_file, NULL));
+    rec->dir = g_path_get_dirname(path);
+    g_free(path);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        event_ring_t   *ring = &rec->ring[i];
+
+        pthread_mutex_init(&ring->lock, NULL);
+        ring->size = (u32)size;
+        ring->frames = STREAM_FRAMERATE * seconds;
+        ring->data = malloc(ring->size);
+        ring->frame = malloc(ring->frames * sizeof(event_frame_t));
+        ring->sync = 1;
+    }
+
+    /* ...writer wakes up on monotonic post-roll deadline */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rec->wait, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&rec->lock, NULL);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        if (!rec->ring[i].data || !rec->ring[i].frame)
+        {
+            TRACE(ERROR, _x("failed to allocate event ring (%u bytes)"), rec->ring[i].size);
+            goto error;
+        }
+    }
+
+    if ((r = pthread_create(&rec->thread, NULL, event_recorder_thread, rec)) != 0)
+    {
+        TRACE(ERROR, _x("failed to create event writer thread: %d"), r);
+        goto error;
+    }
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        sprintf(name, "event_sink_%d", i);
+        sink = gst_bin_get_by_name(GST_BIN(pipeline), name);
+        gst_app_sink_set_callbacks(GST_APP_SINK(sink), &event_sink_callbacks, &rec->ring[i], NULL);
+        gst_object_unref(sink);
+    }
+
+    TRACE(INIT, _b("event recorder: %d sec per camera, %u bytes"), seconds, rec->ring[0].size);
+
+    return rec;
+
+error:
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        free(rec->ring[i].data);
+        free(rec->ring[i].frame);
+    }
+
+    g_free(rec->dir);
+    free(rec);
+    errno = ENOMEM;
+    return NULL;
+}
+
+/*******************************************************************************
+ * Segmented recording
+ ******************************************************************************/
+
+/* ...page-cache flushing of closed segments (NULL if not enabled) */
+static GThreadPool     *__segment_pool;
+
+/* ...expected segment file size (bytes) */
+static off_t stream_segment_bytes(void)
+{
+    if (__record_segment_size)
+    {
+        return (off_t)__record_segment_size << 20;
+    }
+
+    /* ...time-limited segment; allow 25% encoder bitrate overshoot */
+    return (off_t)STREAM_BITRATE / 8 * __record_segment_time / 4 * 5;
+}
+
+/* ...reserve disk space for a new segment so writes do not allocate extents */
+static void stream_segment_opened(const char *location)
+{
+    int     fd;
+
+    if ((fd = open(location, O_WRONLY)) < 0)
+    {
+        TRACE(ERROR, _x("failed to open segment '%s': %m"), location);
+        return;
+    }
+
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, stream_segment_bytes()) < 0)
+    {
+        TRACE(DEBUG, _b("segment '%s' preallocation failed: %m"), location);
+    }
+
+    close(fd);
+}
+
+/* ...make closed segment durable and drop it from page cache (pool thread) */
+static void stream_segment_closed(gpointer data, gpointer user_data)
+{
+    char           *location = data;
+    struct stat     st;
+    int             fd;
+
+    if ((fd = open(location, O_WRONLY)) < 0)
+    {
+        TRACE(ERROR, _x("failed to open segment '%s': %m"), location);
+        g_free(location);
+        return;
+    }
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    /* ...release space reserved beyond actual segment size */
+    if (fstat(fd, &st) == 0 && st.st_size < stream_segment_bytes())
+    {
+        fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, st.st_size, stream_segment_bytes() - st.st_size);
+    }
+
+    close(fd);
+
+    TRACE(INFO, _b("segment '%s' closed"), location);
+
+    g_free(location);
+}
+
+/* ...stream pipeline messages handler (streaming threads) */
+static GstBusSyncReply stream_bus_sync(GstBus *bus, GstMessage *msg, gpointer data)
+{
+    const GstStructure *s;
+    const gchar        *location;
+    GError             *error;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_EOS:
+        /* ...collected on pipeline teardown */
+        return GST_BUS_PASS;
+
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &error, NULL);
+        TRACE(ERROR, _b("stream: %s"), error->message);
+        g_error_free(error);
+        return GST_BUS_PASS;
+
+    case GST_MESSAGE_ELEMENT:
+        s = gst_message_get_structure(msg);
+
+        if (!__segment_pool || !(location = gst_structure_get_string(s, "location")))
+        {
+            break;
+        }
+
+        if (gst_structure_has_name(s, "splitmuxsink-fragment-opened"))
+        {
+            stream_segment_opened(location);
+        }
+        else if (gst_structure_has_name(s, "splitmuxsink-fragment-closed"))
+        {
+            g_thread_pool_push(__segment_pool, g_strdup(location), NULL);
+        }
+
+        break;
+
+    default:
+        break;
+    }
+
+    /* ...nobody polls the bus; do not let messages pile up */
+    return GST_BUS_DROP;
+}
+
+/* ...build muxer destinations of recording branches and sink description */
+static char * stream_recording_sink(app_data_t *app, char (*pad)[16])
+{
+    GString    *sink = g_string_new(NULL);
+    char       *base, *ext, *path, *dir;
+    int         i;
+
+    /* ...plain file name is placed into recording directory */
+    path = (g_path_is_absolute(app->stream_file) ? g_strdup(app->stream_file) : g_build_filename(__record_dir, app->stream_file, NULL));
+
+    if (__record_segment_time == 0 && __record_segment_size == 0)
+    {
+        /* ...single file with all cameras as tracks */
+        for (i = 0; i < CAMERAS_NUMBER; i++)
+        {
+            sprintf(pad[i], "mux.video_%d", i);
+        }
+
+        g_string_append_printf(sink, PIPELINE_FILESINK, path);
+        g_free(path);
+
+        return g_string_free(sink, FALSE);
+    }
+
+    /* ...segments of each camera are named after recording file and placed next to it */
+    base = g_path_get_basename(path);
+    dir = g_path_get_dirname(path);
+    (ext = strrchr(base, '.')) ? *ext = '\0' : 0;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        sprintf(pad[i], "mux_%d.video", i);
+
+        g_string_append_printf(sink, PIPELINE_SEGMENTSINK,
+                               i, dir, base, i,
+                               (guint64)__record_segment_time * GST_SECOND,
+                               (guint64)__record_segment_size << 20,
+                               __record_keep,
+                               (__record_segment_size ? "false" : "true"));
+    }
+
+    g_free(base);
+    g_free(dir);
+    g_free(path);
+
+    return g_string_free(sink, FALSE);
+}
+
+/*******************************************************************************
+ * Encoder input queues
+ ******************************************************************************/
+
+/* ...number of buffers queued in appsrc (attached to appsrc object) */
+static GQuark           __stream_queued_quark;
+
+/* ...buffer left appsrc queue */
+static GstPadProbeReturn stream_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    __atomic_sub_fetch((int *)data, 1, __ATOMIC_RELEASE);
+
+    return GST_PAD_PROBE_OK;
+}
+
+/* ...attach queue level tracking to appsrc */
+static void stream_src_configure(GstAppSrc *src)
+{
+    GstPad     *pad = gst_element_get_static_pad(GST_ELEMENT(src), "src");
+    int        *queued = g_new0(int, 1);
+
+    /* ...counter lives as long as appsrc; buffers flushed on teardown need no accounting */
+    g_object_set_qdata_full(G_OBJECT(src), __stream_queued_quark, queued, g_free);
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, stream_src_probe, queued, NULL);
+    gst_object_unref(pad);
+}
+
+/*******************************************************************************
+ * Network rate control
+ ******************************************************************************/
+
+/* ...control period (msec) */
+#define STREAM_RATE_PERIOD              250
+
+/* ...maximal frame decimation factor */
+#define STREAM_RATE_DECIMATE            4
+
+/* ...send queue occupancy thresholds (percent of socket buffer) */
+#define STREAM_RATE_CONGESTED           50
+#define STREAM_RATE_CLEAR               10
+
+/* ...receiver-reported loss considered congestion (percent) */
+#define STREAM_RATE_LOSS                2
+
+/* ...per-camera rate state */
+typedef struct stream_rate_cam
+{
+    /* ...encoder and network sink of the branch */
+    GstElement         *enc, *udp;
+
+    /* ...current encoder bitrate (bit/s) */
+    u32                 bitrate;
+
+    /* ...every N-th camera frame is encoded (read by decoding thread) */
+    int                 decimate;
+
+    /* ...camera frames sequence counter (decoding thread only) */
+    u32                 seq;
+
+    /* ...last receiver-reported loss (percent; -1 if none since last period) */
+    int                 loss;
+
+}   stream_rate_cam_t;
+
+/* ...rate controller data */
+struct stream_rate
+{
+    /* ...per-camera state */
+    stream_rate_cam_t   cam[CAMERAS_NUMBER];
+
+    /* ...bitrate limits per camera (bit/s) */
+    u32                 min, max;
+
+    /* ...receiver feedback socket (-1 if not enabled) */
+    int                 sock;
+
+    /* ...termination event */
+    int                 efd;
+
+    /* ...controller thread */
+    pthread_t           thread;
+};
+
+/* ...bytes pending in a socket send queue (percent of its buffer; -1 if unknown) */
+static int stream_rate_occupancy(GstElement *udp)
+{
+    GSocket    *socket = NULL;
+    int         fd, outq, sndbuf;
+    socklen_t   len = sizeof(sndbuf);
+
+    g_object_get(udp, "used-socket", &socket, NULL);
+
+    if (socket == NULL)
+    {
+        return -1;
+    }
+
+    fd = g_socket_get_fd(socket);
+
+    if (ioctl(fd, SIOCOUTQ, &outq) < 0 || getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) < 0 || sndbuf <= 0)
+    {
+        outq = -1;
+    }
+    else
+    {
+        outq = (int)((s64)outq * 100 / sndbuf);
+    }
+
+    g_object_unref(socket);
+
+    return outq;
+}
+
+/* ...receive feedback datagram "<camera> <loss-percent>" */
+static void stream_rate_feedback(stream_rate_t *rate)
+{
+    char    msg[64];
+    ssize_t n;
+    int     i, loss;
+
+    while ((n = recv(rate->sock, msg, sizeof(msg) - 1, MSG_DONTWAIT)) > 0)
+    {
+        msg[n] = '\0';
+
+        if (sscanf(msg, "%d %d", &i, &loss) != 2 || i < 0 || i >= CAMERAS_NUMBER)
+        {
+            TRACE(DEBUG, _b("stream: malformed feedback '%s'"), msg);
+            continue;
+        }
+
+        /* ...worst report within a period counts */
+        rate->cam[i].loss = (loss > rate->cam[i].loss ? loss : rate->cam[i].loss);
+    }
+}
+
+/* ...adjust encoder bitrate and decimation of a camera branch */
+static void stream_rate_update(stream_rate_t *rate, int i)
+{
+    stream_rate_cam_t  *c = &rate->cam[i];
+    int                 occupancy = stream_rate_occupancy(c->udp);
+    int                 decimate = c->decimate;
+    u32                 bitrate = c->bitrate;
+
+    if (occupancy > STREAM_RATE_CONGESTED || c->loss > STREAM_RATE_LOSS)
+    {
+        /* ...back off multiplicatively; skip frames once bitrate floor is hit */
+        if (bitrate > rate->min)
+        {
+            bitrate = MAX(rate->min, bitrate / 4 * 3);
+        }
+        else if (decimate < STREAM_RATE_DECIMATE)
+        {
+            decimate++;
+        }
+    }
+    else if (occupancy >= 0 && occupancy < STREAM_RATE_CLEAR && c->loss <= 0)
+    {
+        /* ...restore frame rate first, then probe bitrate additively */
+        if (decimate > 1)
+        {
+            decimate--;
+        }
+        else if (bitrate < rate->max)
+        {
+            bitrate = MIN(rate->max, bitrate + rate->max / 16);
+        }
+    }
+
+    if (bitrate != c->bitrate || decimate != c->decimate)
+    {
+        TRACE(DEBUG, _b("camera-%d: send queue %d%%, loss %d%%: bitrate %u, decimate %d"),
+              i, occupancy, c->loss, bitrate, decimate);
+
+        g_object_set(c->enc, __stream_backend->bitrate, (guint)(bitrate / __stream_backend->unit), NULL);
+        c->bitrate = bitrate;
+        __atomic_store_n(&c->decimate, decimate, __ATOMIC_RELAXED);
+    }
+
+    c->loss = -1;
+}
+
+/* ...controller thread */
+static void * stream_rate_thread(void *arg)
+{
+    stream_rate_t  *rate = arg;
+    struct pollfd   pfd[2];
+    gint64          deadline = g_get_monotonic_time();
+    int             i, timeout;
+
+    pfd[0].fd = rate->efd, pfd[0].events = POLLIN;
+    pfd[1].fd = rate->sock, pfd[1].events = POLLIN;
+
+    while (1)
+    {
+        timeout = (int)((deadline - g_get_monotonic_time()) / 1000);
+
+        if (timeout <= 0)
+        {
+            for (i = 0; i < CAMERAS_NUMBER; i++)
+            {
+                stream_rate_update(rate, i);
+            }
+
+            deadline += STREAM_RATE_PERIOD * 1000;
+            continue;
+        }
+
+        /* ...negative descriptor of disabled feedback is ignored by poll */
+        if (poll(pfd, 2, timeout) < 0 && errno != EINTR)
+        {
+            TRACE(ERROR, _x("stream: rate control poll failed: %m"));
+            break;
+        }
+
+        if (pfd[0].revents & POLLIN)
+        {
+            break;
+        }
+
+        if (pfd[1].revents & POLLIN)
+        {
+            stream_rate_feedback(rate);
+        }
+    }
+
+    return NULL;
+}
+
+/* ...check if camera frame is to be skipped (decoding thread) */
+static inline int stream_rate_skip(stream_rate_t *rate, int i)
+{
+    stream_rate_cam_t  *c = &rate->cam[i];
+
+    return (c->seq++ % __atomic_load_n(&c->decimate, __ATOMIC_RELAXED)) != 0;
+}
+
+/* ...destroy controller (before pipeline is stopped) */
+static void stream_rate_destroy(stream_rate_t *rate)
+{
+    int     i;
+
+    eventfd_write(rate->efd, 1);
+    pthread_join(rate->thread, NULL);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        g_clear_object(&rate->cam[i].enc);
+        g_clear_object(&rate->cam[i].udp);
+    }
+
+    (rate->sock >= 0 ? close(rate->sock) : 0);
+    close(rate->efd);
+    free(rate);
+}
+
+/* ...find branch element made by a factory, downstream of an appsrc */
+static GstElement * stream_branch_find(GstElement *e, const char *factory)
+{
+    GstElementFactory  *f;
+    GstPad             *pad, *peer;
+
+    gst_object_ref(e);
+
+    while (1)
+    {
+        f = gst_element_get_factory(e);
+
+        if (f && !strcmp(GST_OBJECT_NAME(f), factory))
+        {
+            return e;
+        }
+
+        /* ...encoder precedes any tee, so branch is a plain chain up to it */
+        pad = gst_element_get_static_pad(e, "src");
+        gst_object_unref(e);
+
+        if (pad == NULL)
+        {
+            return NULL;
+        }
+
+        peer = gst_pad_get_peer(pad);
+        gst_object_unref(pad);
+
+        if (peer == NULL)
+        {
+            return NULL;
+        }
+
+        e = gst_pad_get_parent_element(peer);
+        gst_object_unref(peer);
+
+        if (e == NULL)
+        {
+            return NULL;
+        }
+    }
+}
+
+/* ...create controller of network branches of a started pipeline */
+static stream_rate_t * stream_rate_create(GstPipeline *pipeline, GstAppSrc **appsrc)
+{
+    struct sockaddr_in  addr;
+    stream_rate_t      *rate;
+    stream_rate_cam_t  *c;
+    char                name[16];
+    int                 i, r;
+
+    CHK_ERR(rate = calloc(1, sizeof(*rate)), (errno = ENOMEM, NULL));
+
+    rate->sock = -1;
+
+    /* ...uplink budget is split evenly; floor keeps a picture recognizable */
+    rate->max = MIN((u64)__stream_budget * 1000 / CAMERAS_NUMBER, STREAM_BITRATE);
+    rate->min = rate->max / 8;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        c = &rate->cam[i];
+
+        sprintf(name, "stream_udp_%d", i);
+        c->udp = gst_bin_get_by_name(GST_BIN(pipeline), name);
+        c->enc = stream_branch_find(GST_ELEMENT(appsrc[i]), __stream_backend->elements[1]);
+
+        if (!c->udp || !c->enc)
+        {
+            TRACE(ERROR, _b("camera-%d: network branch not found"), i);
+            errno = ENOENT;
+            goto error;
+        }
+
+        /* ...start at the budget share and let the controller probe downwards */
+        g_object_set(c->enc, __stream_backend->bitrate, (guint)(rate->max / __stream_backend->unit), NULL);
+        c->bitrate = rate->max;
+        c->decimate = 1;
+        c->loss = -1;
+    }
+
+    if (__stream_feedback_port)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(__stream_feedback_port);
+
+        if ((rate->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0 ||
+            bind(rate->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            TRACE(ERROR, _x("stream: failed to open feedback port %d: %m"), __stream_feedback_port);
+            goto error;
+        }
+    }
+
+    if ((rate->efd = eventfd(0, EFD_CLOEXEC)) < 0)
+    {
+        TRACE(ERROR, _x("stream: failed to create eventfd: %m"));
+        goto error;
+    }
+
+    if ((r = pthread_create(&rate->thread, NULL, stream_rate_thread, rate)) != 0)
+    {
+        TRACE(ERROR, _x("stream: failed to create rate control thread: %d"), r);
+        close(rate->efd);
+        errno = r;
+        goto error;
+    }
+
+    TRACE(INIT, _b("stream: rate control %u..%u bit/s per camera, feedback port %d"),
+          rate->min, rate->max, __stream_feedback_port);
+
+    return rate;
+
+error:
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        g_clear_object(&rate->cam[i].enc);
+        g_clear_object(&rate->cam[i].udp);
+    }
+
+    (rate->sock >= 0 ? close(rate->sock) : 0);
+    free(rate);
+    return NULL;
+}
+
+/*******************************************************************************
+ * DMA buffers hand-off
+ ******************************************************************************/
+
+/* ...maximal number of camera buffers held by an encoder branch */
+#define STREAM_DMABUF_INFLIGHT          2
+
+/* ...allocator wrapping exported camera planes (NULL if hand-off is disabled) */
+static GstAllocator    *__stream_allocator;
+
+/* ...camera buffers currently held by encoder branches */
+static int              __stream_inflight[CAMERAS_NUMBER];
+
+/* ...camera buffer wrapper released by encoder branch */
+static void stream_dmabuf_release(gpointer data, GstMiniObject *obj)
+{
+    __atomic_sub_fetch((int *)data, 1, __ATOMIC_RELEASE);
+}
+
+/* ...describe planes layout of a wrapper (VSP needs offsets and strides of semi-planar formats) */
+static void stream_dmabuf_video_meta(GstBuffer *dma, GstBuffer *buffer, vsink_meta_t *vmeta)
+{
+    GstVideoMeta   *meta = gst_buffer_get_video_meta(buffer);
+    gsize           offset[GST_VIDEO_MAX_PLANES] = { 0 };
+    gint            stride[GST_VIDEO_MAX_PLANES] = { 0 };
+    GstVideoInfo    info;
+    int             k;
+
+    if (meta)
+    {
+        gst_buffer_add_video_meta_full(dma, meta->flags, meta->format, meta->width, meta->height,
+                                       meta->n_planes, meta->offset, meta->stride);
+        return;
+    }
+
+    gst_video_info_set_format(&info, vmeta->format, vmeta->width, vmeta->height);
+
+    for (k = 0; k < vmeta->n_planes; k++)
+    {
+        /* ...plane is either a separate memory or located within the first one */
+        offset[k] = (k < vmeta->n_dma ? gst_buffer_get_sizes_range(buffer, 0, k, NULL, NULL) :
+                     (gsize)((u8 *)vmeta->plane[k] - (u8 *)vmeta->plane[0]));
+        stride[k] = vmeta->stride[k] ? : GST_VIDEO_INFO_PLANE_STRIDE(&info, k);
+    }
+
+    gst_buffer_add_video_meta_full(dma, GST_VIDEO_FRAME_FLAG_NONE, vmeta->format, vmeta->width, vmeta->height,
+                                   vmeta->n_planes, offset, stride);
+}
+
+/* ...wrap exported camera planes into DMA memory (NULL if buffer is not exported) */
+static GstBuffer * stream_dmabuf_wrap(GstBuffer *buffer)
+{
+    vsink_meta_t   *vmeta = gst_buffer_get_vsink_meta(buffer);
+    GstBuffer      *dma;
+    GstMemory      *mem, *m;
+    int             k, fd;
+
+    if (!vmeta || vmeta->n_dma == 0 || vmeta->n_dma != (int)gst_buffer_n_memory(buffer))
+    {
+        return NULL;
+    }
+
+    dma = gst_buffer_new();
+
+    for (k = 0; k < vmeta->n_dma; k++)
+    {
+        /* ...memory object owns a descriptor; camera keeps its own */
+        mem = gst_buffer_peek_memory(buffer, k);
+
+        if (mem->size == 0 || (fd = dup(vmeta->dmafd[k])) < 0)
+        {
+            gst_buffer_unref(dma);
+            return NULL;
+        }
+
+        /* ...plane may start at an offset within exported buffer */
+        m = gst_dmabuf_allocator_alloc(__stream_allocator, fd, mem->offset + mem->size);
+        gst_memory_resize(m, mem->offset, mem->size);
+        gst_buffer_append_memory(dma, m);
+    }
+
+    stream_dmabuf_video_meta(dma, buffer, vmeta);
+
+    /* ...camera buffer returns to a pool only once encoder branch releases the wrapper */
+    gst_buffer_copy_into(dma, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    gst_buffer_add_parent_buffer_meta(dma, buffer);
+
+    return dma;
+}
+
+/* ...switch VSP input to DMA import */
+static void stream_dmabuf_configure(GstPipeline *pipeline)
+{
+    GstIterator    *it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+    GValue          item = G_VALUE_INIT;
+    GstElement     *e;
+    GstElementFactory  *f;
+
+    while (gst_iterator_next(it, &item) == GST_ITERATOR_OK)
+    {
+        e = g_value_get_object(&item);
+        f = gst_element_get_factory(e);
+
+        if (f && !strcmp(GST_OBJECT_NAME(f), "vspfilter"))
+        {
+            gst_util_set_object_arg(G_OBJECT(e), "input-io-mode", "dmabuf-import");
+        }
+
+        g_value_reset(&item);
+    }
+
+    g_value_unset(&item);
+    gst_iterator_free(it);
+}
+
+/* ...maximal time to wait for recording finalization */
+#define STREAM_EOS_TIMEOUT              (2 * GST_SECOND)
+
+/* ...streaming pipeline instance (built and destroyed off the application lock) */
+typedef struct stream_instance
+{
+    /* ...pipeline handle */
+    GstPipeline        *pipeline;
+
+    /* ...appsrc nodes feeding the pipeline */
+    GstAppSrc          *appsrc[CAMERAS_NUMBER];
+
+    /* ...pipeline type */
+    int                 state;
+
+    /* ...encoded frames rings (event recording pipeline only) */
+    event_recorder_t   *event;
+
+    /* ...network rate controller (NULL if not enabled) */
+    stream_rate_t      *rate;
+
+    /* ...camera buffers are imported by VSP as DMA buffers */
+    int                 dmabuf;
+
+}   stream_instance_t;
+
+/* ...stop and release pipeline instance */
+static void stream_instance_destroy(stream_instance_t *s)
+{
+    GstBus     *bus;
+    GstMessage *msg;
+    int         i;
+
+    if (s->pipeline == NULL)
+    {
+        return;
+    }
+
+    /* ...controller touches encoders; stop it first */
+    if (s->rate)
+    {
+        stream_rate_destroy(s->rate);
+    }
+
+    /* ...let muxer finalize the file; nothing waits for us here */
+    if (s->state == RECORDING || s->state == COMBINED)
+    {
+        for (i = 0; i < CAMERAS_NUMBER; i++)
+        {
+            gst_app_src_end_of_stream(s->appsrc[i]);
+        }
+
+        bus = gst_pipeline_get_bus(s->pipeline);
+
+        if ((msg = gst_bus_timed_pop_filtered(bus, STREAM_EOS_TIMEOUT, GST_MESSAGE_EOS | GST_MESSAGE_ERROR)) != NULL)
+        {
+            gst_message_unref(msg);
+        }
+        else
+        {
+            TRACE(WARNING, _b("stream: recording finalization timeout"));
+        }
+
+        gst_object_unref(bus);
+    }
+
+    gst_element_set_state(GST_ELEMENT(s->pipeline), GST_STATE_NULL);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        g_object_unref(s->appsrc[i]);
+    }
+
+    g_object_unref(s->pipeline);
+
+    /* ...encoders are stopped; write pending event segment */
+    if (s->event)
+    {
+        event_recorder_destroy(s->event);
+    }
+
+    TRACE(INFO, _b("stream: pipeline %d destroyed"), s->state);
+
+    memset(s, 0, sizeof(*s));
+}
+
+/* ...exchange active pipeline; buffers are pushed under the same lock */
+static void stream_instance_swap(app_data_t *app, stream_instance_t *s)
+{
+    stream_instance_t   old;
+    int                 i;
+
+    pthread_mutex_lock(&app->lock);
+
+    old.pipeline = app->stream_pipeline, app->stream_pipeline = s->pipeline;
+    old.state = app->stream_state, app->stream_state = s->state;
+    old.event = app->stream_event, app->stream_event = s->event;
+    old.rate = app->stream_rate, app->stream_rate = s->rate;
+    old.dmabuf = app->stream_dmabuf, app->stream_dmabuf = s->dmabuf;
+
+    /* ...all cameras feed a new pipeline */
+    app->stream_cameras = (1U << CAMERAS_NUMBER) - 1;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        old.appsrc[i] = app->stream_appsrc[i], app->stream_appsrc[i] = s->appsrc[i];
+    }
+
+    pthread_mutex_unlock(&app->lock);
+
+    *s = old;
+}
+
+/* ...build and start pipeline instance */
+static int stream_instance_create(app_data_t *app, int state, stream_instance_t *s)
+{
+    GString* str;
+    char* sink;
+    char pad[CAMERAS_NUMBER][16];
+    char enc[512];
+    GstPipeline* pipeline;
+    GstBus* bus;
+    int w = app->sv_cfg->cam_width, h = app->sv_cfg->cam_height;
+    int port = app->stream_base_port;
+    int i;
+
+    /* ...recording destination (single file or segments) */
+    sink = stream_recording_sink(app, pad);
+
+    str = g_string_new(NULL);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        /* ...per-camera encoder (software back-ends ignore VSP devices) */
+        snprintf(enc, sizeof(enc), __stream_backend->encoder,
+                 vsp_devices[2 * i], vsp_devices[2 * i + 1]);
+
+        switch (state)
+        {
+        case STREAMING:
+            g_string_append_printf(str, STREAMING_PIPELINE, i, w, h,
+                                   enc, __stream_payloader, i, app->stream_ip, port + i);
+            break;
+        case RECORDING:
+            g_string_append_printf(str, RECORDING_PIPELINE, i, w, h, enc, pad[i]);
+            break;
+        case COMBINED:
+            g_string_append_printf(str, COMBINED_PIPELINE, i, w, h, enc, i,
+                                   i, pad[i], i, __stream_payloader, i, app->stream_ip, port + i);
+            break;
+        case EVENT:
+            g_string_append_printf(str, EVENT_PIPELINE, i, w, h, enc, i);
+            break;
+        default:
+            TRACE(ERROR, _b("stream: unknown state %d"), state);
+            g_string_free(str, TRUE);
+            g_free(sink);
+            return -1;
+        }
+    }
+
+    /* ...muxer and file sink are shared by all recorded cameras */
+    if (state == RECORDING || state == COMBINED)
+    {
+        g_string_append(str, sink);
+    }
+
+    g_free(sink);
+
+    pipeline = GST_PIPELINE(gst_parse_launch(str->str, NULL));
+
+    TRACE(INFO, _b("stream: pipeline \"%s\""), str->str);
+
+    g_string_free(str, TRUE);
+
+    CHK_ERR(pipeline, -EINVAL);
+
+    /* ...handle segment files and errors in place of a bus watch */
+    bus = gst_pipeline_get_bus(pipeline);
+    gst_bus_set_sync_handler(bus, stream_bus_sync, NULL, NULL);
+    gst_object_unref(bus);
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        char    name[16];
+
+        sprintf(name, "stream_src_%d", i);
+        s->appsrc[i] = GST_APP_SRC(gst_bin_get_by_name(GST_BIN (pipeline), name));
+
+        g_object_set(s->appsrc[i],
+                     "stream-type", 0,
+                     "is-live", TRUE,
+                     "format", GST_FORMAT_TIME,
+                     "num-buffers", app->stream_frame_count == 0 ? -1 : app->stream_frame_count,
+                     "max-bytes", 0,
+                     "block", FALSE,
+                     NULL);
+
+        /* ...queue is bounded by buffers count rather than bytes */
+        stream_src_configure(s->appsrc[i]);
+    }
+
+    s->pipeline = pipeline;
+    s->state = state;
+
+    /* ...camera planes are imported by VSP directly; decided once per pipeline */
+    pthread_mutex_lock(&app->lock);
+    s->dmabuf = (__stream_allocator && app->track_dmabuf);
+    pthread_mutex_unlock(&app->lock);
+
+    if (s->dmabuf)
+    {
+        stream_dmabuf_configure(pipeline);
+    }
+    else if (__stream_allocator)
+    {
+        TRACE(INFO, _b("stream: camera buffers are not exported; DMA hand-off disabled"));
+    }
+
+    /* ...event recorder storage is allocated once per pipeline */
+    if (state == EVENT && (s->event = event_recorder_create(app, pipeline)) == NULL)
+    {
+        TRACE(ERROR, _x("stream: failed to create event recorder: %m"));
+        stream_instance_destroy(s);
+        return -1;
+    }
+
+    /* ...open devices and allocate encoders before pipeline gets visible to decoders */
+    if (gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+        gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        TRACE(ERROR, _b("stream: failed to start pipeline %d"), state);
+        stream_instance_destroy(s);
+        return -1;
+    }
+
+    /* ...network branches are kept within uplink budget (sockets exist once started) */
+    if (__stream_budget && (state == STREAMING || state == COMBINED) &&
+        (s->rate = stream_rate_create(pipeline, s->appsrc)) == NULL)
+    {
+        TRACE(ERROR, _x("stream: failed to create rate controller: %m"));
+        stream_instance_destroy(s);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ...create streaming instance (application lock must not be held) */
+GstPipeline* stream_pipeline_start(app_data_t *app, int state)
+{
+    stream_instance_t   s;
+    GstPipeline        *pipeline;
+
+    memset(&s, 0, sizeof(s));
+
+    if (stream_instance_create(app, state, &s) < 0)
+    {
+        return NULL;
+    }
+
+    /* ...attach new pipeline; release whatever has been active */
+    pipeline = s.pipeline;
+    stream_instance_swap(app, &s);
+    stream_instance_destroy(&s);
+
+    return pipeline;
+}
+
+
+/* ...Stop network stream (application lock must not be held) */
+int stream_pipeline_stop(app_data_t *app)
+{
+    stream_instance_t   s;
+
+    memset(&s, 0, sizeof(s));
+
+    /* ...detach pipeline from decoders first and tear it down afterwards */
+    stream_instance_swap(app, &s);
+    stream_instance_destroy(&s);
+
+    return 0;
+}
 
-#define RECORDING_PIPELINE "appsrc name=stream_src_%d ! " \
-    "video/x-raw,width=%d,format=UYVY,framerate=30/1,height=%d ! " \
-    "vspfilter devfile-input=%s devfile-output=%s input-io-mode=userptr ! queue ! " \
-    "video/x-raw,format=NV12 ! " \
-    "omxh264enc use-dmabuf=true num-p-frames=29 control-rate=2 " \
-    "target-bitrate=4000000 ! video/x-h264,profile=high ! h264parse ! " \
-    "mux.video_%d "
+/* ...create streaming instance */
+int stream_pipeline_push_buffer(app_data_t *app, int i, GstPipeline* pipeline, GstBuffer* buffer)
+{
+    GstAppSrc *src = app->stream_appsrc[i];
+    int *queued = g_object_get_qdata(G_OBJECT(src), __stream_queued_quark);
+    GstBuffer *dma;
+    int ret;
 
-#define PIPELINE_FILESINK " matroskamux name=mux ! filesink location=%s "
+    /* ...camera branch has been stopped through control socket */
+    if (!(app->stream_cameras & (1U << i)))
+    {
+        gst_buffer_unref(buffer);
+        return 0;
+    }
 
-#define COMBINED_PIPELINE "appsrc name=stream_src_%d ! " \
-    "video/x-raw,width=%d,format=UYVY,framerate=30/1,height=%d ! " \
-    "vspfilter devfile-input=%s devfile-output=%s input-io-mode=userptr ! queue ! " \
-    "video/x-raw,format=NV12 ! " \
-    "omxh264enc use-dmabuf=true num-p-frames=29 control-rate=2 " \
-    "target-bitrate=4000000 ! video/x-h264,profile=high ! tee name=t_%d " \
-    "t_%d.src_0 ! queue ! video/x-h264,profile=high ! h264parse ! mux.video_%d "\
-    "t_%d.src_1 ! queue ! video/x-h264,profile=high ! ieee1722pay ! " \
-    "udpsink host=%s port=%d sync=false "
+    /* ...frame rate is reduced by rate controller on congested uplink */
+    if (app->stream_rate && stream_rate_skip(app->stream_rate, i))
+    {
+        app->stream_dropped[i]++;
+        gst_buffer_unref(buffer);
+        return 0;
+    }
 
-/* ...create streaming instance */
-GstPipeline* stream_pipeline_start(app_data_t *app, int state)
+    /* ...leaky queue: newest frame is dropped if encoder branch falls behind */
+    if (__atomic_load_n(queued, __ATOMIC_ACQUIRE) >= __stream_queue)
+    {
+        TRACE(BUFFER, _b("camera-%d: streamer queue full; buffer dropped"), i);
+        app->stream_dropped[i]++;
+        gst_buffer_unref(buffer);
+        return 0;
+    }
+
+    if (app->stream_dmabuf)
+    {
+        /* ...encoder branch is late; do not let it drain camera buffers pool */
+        if (__atomic_load_n(&__stream_inflight[i], __ATOMIC_ACQUIRE) >= STREAM_DMABUF_INFLIGHT)
+        {
+            TRACE(BUFFER, _b("camera-%d: encoder busy; buffer dropped"), i);
+            app->stream_dropped[i]++;
+            gst_buffer_unref(buffer);
+            return 0;
+        }
+
+        /* ...VSP input is configured for import; unexported buffer cannot be passed */
+        if ((dma = stream_dmabuf_wrap(buffer)) == NULL)
+        {
+            TRACE(BUFFER, _b("camera-%d: buffer is not exported; buffer dropped"), i);
+            app->stream_dropped[i]++;
+            gst_buffer_unref(buffer);
+            return 0;
+        }
+
+        __atomic_add_fetch(&__stream_inflight[i], 1, __ATOMIC_RELAXED);
+        gst_mini_object_weak_ref(GST_MINI_OBJECT(dma), stream_dmabuf_release, &__stream_inflight[i]);
+
+        /* ...wrapper holds its own reference to camera buffer */
+        gst_buffer_unref(buffer), buffer = dma;
+    }
+
+    /* ...buffer ownership is taken even if push fails */
+    __atomic_add_fetch(queued, 1, __ATOMIC_RELAXED);
+    ret = gst_app_src_push_buffer(src, buffer);
+
+    if (ret != GST_FLOW_OK)
+    {
+        __atomic_sub_fetch(queued, 1, __ATOMIC_RELAXED);
+        app->stream_dropped[i]++;
+        TRACE(ERROR, _b("camera-%d: failed to push  buffer in streamer"), i);
+        return -1;
+    }
+
+    app->stream_pushed[i]++;
+
+    TRACE(BUFFER, _b("camera-%d: pushed  buffer in streamer"), i);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Control channels
+ ******************************************************************************/
+
+/* ...file name of recordings set through control socket */
+static char            *__stream_control_file;
+
+/* ...requests executor; pipeline transitions are kept off the main loop */
+static GThreadPool     *__stream_control_pool;
+
+/* ...switch pipeline state (stream lock held) */
+static int stream_control_state(app_data_t *app, int cmd)
 {
-    char* str;
-    GstPipeline* pipeline;
-    int ret = 0;
-    int i;
+    if (app->stream_state == cmd)
+    {
+        return 0;
+    }
 
-    switch (state)
+    switch (cmd)
     {
+    case DISABLED:
+        /* Disable streaming and recording */
+        TRACE(INFO, _b("Disable all"));
+        stream_pipeline_stop(app);
+        return 0;
+
     case STREAMING:
-        ret = asprintf(&str,
-                       STREAMING_PIPELINE STREAMING_PIPELINE
-                       STREAMING_PIPELINE STREAMING_PIPELINE
-#if defined STREAM_5TH_CAM
-                       STREAMING_PIPELINE
-#endif
-                       ,
-                       0, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[0], vsp_devices[1], app->stream_ip, app->stream_base_port,
-                       1, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[2], vsp_devices[3], app->stream_ip, app->stream_base_port + 1,
-                       2, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[4], vsp_devices[5], app->stream_ip, app->stream_base_port + 2,
-                       3, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[6], vsp_devices[7], app->stream_ip, app->stream_base_port + 3
-#if defined STREAM_5TH_CAM
-                       , 4, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[8], vsp_devices[9], app->stream_ip, app->stream_base_port + 4
-#endif
-            );
-        break;
     case RECORDING:
-        ret = asprintf(&str,
-                       RECORDING_PIPELINE RECORDING_PIPELINE
-                       RECORDING_PIPELINE RECORDING_PIPELINE
-#if defined STREAM_5TH_CAM
-                       RECORDING_PIPELINE
-#endif
-                       PIPELINE_FILESINK,
-                       0, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[0], vsp_devices[1], 0,
-                       1, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[2], vsp_devices[3], 1,
-                       2, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[4], vsp_devices[5], 2,
-                       3, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[6], vsp_devices[7], 3,
-#if defined STREAM_5TH_CAM
-                       4, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[8], vsp_devices[9], 4,
-#endif
-                       app->stream_file);
-        break;
     case COMBINED:
-        ret = asprintf(&str, COMBINED_PIPELINE COMBINED_PIPELINE
-                       COMBINED_PIPELINE COMBINED_PIPELINE
-#if defined STREAM_5TH_CAM
-                       COMBINED_PIPELINE
-#endif
-                       PIPELINE_FILESINK,
-                       0, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[0], vsp_devices[1], 0, 0, 0, 0, app->stream_ip,
-                       app->stream_base_port,
-                       1, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[2], vsp_devices[3], 1, 1, 1, 1, app->stream_ip,
-                       app->stream_base_port + 1,
-                       2, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[4], vsp_devices[5], 2, 2, 2, 2, app->stream_ip,
-                       app->stream_base_port + 2 ,
-                       3, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[6], vsp_devices[7], 3, 3, 3, 3, app->stream_ip,
-                       app->stream_base_port + 3,
-#if defined STREAM_5TH_CAM
-                       4, app->sv_cfg->cam_width, app->sv_cfg->cam_height,
-                       vsp_devices[8], vsp_devices[9], 4, 4, 4, 4, app->stream_ip,
-                       app->stream_base_port + 4,
-#endif
-                       app->stream_file);        
-        break;
+    case EVENT:
+        TRACE(INFO, _b("Destroy pipeline"));
+
+        if (app->stream_state != DISABLED)
+        {
+            stream_pipeline_stop(app);
+        }
+
+        TRACE(INFO, _b("Start streaming: command %d"), cmd);
+
+        if (stream_pipeline_start(app, cmd) == NULL)
+        {
+            TRACE(ERROR, _b("stream failed"));
+            return -EIO;
+        }
+
+        return 0;
+
+    case EVENT_TRIGGER:
+        /* ...write pre-roll and post-roll of event recording pipeline */
+        if (app->stream_event)
+        {
+            event_recorder_trigger(app->stream_event);
+            return 0;
+        }
+
+        TRACE(ERROR, _b("event recording is not active"));
+        return -ENODEV;
+
     default:
-        TRACE(ERROR, _b("stream: unknown state %d"), app->stream_state);
-        return NULL;
+        TRACE(ERROR, _b("unknown control command %d"), cmd);
+        return -EINVAL;
+    }
+}
+
+/* ...start or stop feeding a camera branch (stream lock held) */
+static int stream_control_camera(app_data_t *app, int i, int enable)
+{
+    int     shared = (app->stream_state == RECORDING || app->stream_state == COMBINED) &&
+                     !__record_segment_time && !__record_segment_size;
+
+    CHK_ERR(i >= 0 && i < CAMERAS_NUMBER, -EINVAL);
+
+    /* ...single-file muxer waits for every track; stopping one stalls all */
+    if (!enable && shared)
+    {
+        TRACE(ERROR, _b("camera-%d: cannot stop a track of single-file recording"), i);
+        return -EBUSY;
     }
 
-    if ((ret <= 0) || (!str))
+    pthread_mutex_lock(&app->lock);
+    (enable ? (app->stream_cameras |= 1U << i) : (app->stream_cameras &= ~(1U << i)));
+    pthread_mutex_unlock(&app->lock);
+
+    TRACE(INFO, _b("camera-%d: streaming %s"), i, (enable ? "started" : "stopped"));
+
+    return 0;
+}
+
+/* ...get encoder of a camera branch (stream lock held; NULL if not encoding) */
+static GstElement * stream_control_encoder(app_data_t *app, int i)
+{
+    if (app->stream_state == DISABLED || app->stream_appsrc[i] == NULL)
     {
-        TRACE(ERROR, _b("stream: failed to allocate pipeline string %d"),
-              app->stream_state);
         return NULL;
     }
 
-    pipeline = GST_PIPELINE(gst_parse_launch(str, NULL));
+    return stream_branch_find(GST_ELEMENT(app->stream_appsrc[i]), __stream_backend->elements[1]);
+}
 
-    TRACE(INFO, _b("stream: pipeline \"%s\""), str);
+/* ...set encoder bitrate (stream lock held) */
+static int stream_control_bitrate(app_data_t *app, int camera, int bitrate)
+{
+    GstElement *enc;
+    int         i;
 
-    free(str);
+    /* ...event rings are sized for default bitrate; it is therefore an upper bound */
+    CHK_ERR(camera >= -1 && camera < CAMERAS_NUMBER && bitrate > 0 && bitrate <= STREAM_BITRATE, -EINVAL);
 
-    app->stream_appsrc[0] = GST_APP_SRC(gst_bin_get_by_name(GST_BIN (pipeline), "stream_src_0"));
-    app->stream_appsrc[1] = GST_APP_SRC(gst_bin_get_by_name(GST_BIN (pipeline), "stream_src_1"));
-    app->stream_appsrc[2] = GST_APP_SRC(gst_bin_get_by_name(GST_BIN (pipeline), "stream_src_2"));
-    app->stream_appsrc[3] = GST_APP_SRC(gst_bin_get_by_name(GST_BIN (pipeline), "stream_src_3"));
+    /* ...explicit setting would be overridden on next control period */
+    if (app->stream_rate)
+    {
+        TRACE(ERROR, _b("bitrate is managed by rate control"));
+        return -EBUSY;
+    }
 
-    for (i = 0; i < CAMERAS_NUMBER; i++)
+    for (i = (camera < 0 ? 0 : camera); i < (camera < 0 ? CAMERAS_NUMBER : camera + 1); i++)
     {
-        g_object_set(app->stream_appsrc[i],
-                     "stream-type", 0,
-                     "is-live", TRUE,
-                     "format", GST_FORMAT_TIME,
-                     "num-buffers", app->stream_frame_count == 0 ? -1 : app->stream_frame_count,
-                     "max-bytes", 0,
-                     "block", FALSE,
-                     NULL);
+        if ((enc = stream_control_encoder(app, i)) == NULL)
+        {
+            return -ENODEV;
+        }
+
+        g_object_set(enc, __stream_backend->bitrate, (guint)(bitrate / __stream_backend->unit), NULL);
+        gst_object_unref(enc);
+
+        TRACE(INFO, _b("camera-%d: bitrate set to %d"), i, bitrate);
     }
 
-    app->stream_pipeline = pipeline;
+    return 0;
+}
+
+/* ...set file name of subsequent recordings (stream lock held) */
+static int stream_control_record_path(app_data_t *app, char *path)
+{
+    /* ...message buffer is not necessarily terminated */
+    path[sizeof(((stream_control_msg_t *)0)->path) - 1] = '\0';
 
-    app->stream_state = state;
+    CHK_ERR(path[0] != '\0', -EINVAL);
 
-    gst_element_set_state(GST_ELEMENT(app->stream_pipeline), GST_STATE_PAUSED);
-    gst_element_set_state(GST_ELEMENT(app->stream_pipeline), GST_STATE_PLAYING);
+    g_free(__stream_control_file);
+    app->stream_file = __stream_control_file = g_strdup(path);
 
-    return pipeline;
+    TRACE(INFO, _b("recording file set to '%s'"), path);
+
+    return 0;
 }
 
+/* ...fill state and statistics of a response (stream lock held) */
+static void stream_control_stats(app_data_t *app, stream_control_reply_t *reply)
+{
+    GstElement *enc;
+    guint       bitrate;
+    int         i;
 
-/* ...Stop network stream (set to READY) */
-int stream_pipeline_stop(app_data_t *app)
+    reply->state = app->stream_state;
+    reply->cameras = app->stream_cameras;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        if ((enc = stream_control_encoder(app, i)) != NULL)
+        {
+            g_object_get(enc, __stream_backend->bitrate, &bitrate, NULL);
+            reply->bitrate[i] = bitrate * __stream_backend->unit;
+            gst_object_unref(enc);
+        }
+
+        reply->pushed[i] = app->stream_pushed[i];
+        reply->dropped[i] = app->stream_dropped[i];
+    }
+}
+
+/* ...check if previous track is being torn down */
+static int stream_control_switching(app_data_t *app)
 {
-    int i;
+    int     eos;
 
-    gst_element_set_state (GST_ELEMENT(app->stream_pipeline), GST_STATE_NULL);
-    g_object_unref(app->stream_pipeline);
+    pthread_mutex_lock(&app->lock);
+    eos = app->flags & APP_FLAG_EOS;
+    pthread_mutex_unlock(&app->lock);
 
-    app->stream_pipeline = NULL;
+    return eos;
+}
 
-    for (i = 0; i < CAMERAS_NUMBER; i++)
+/* ...process control socket request */
+static int stream_control_request(app_data_t *app, stream_control_msg_t *msg)
+{
+    switch (msg->type)
     {
-        g_object_unref(app->stream_appsrc[i]);
+    case STREAM_CTL_STATE:
+        return stream_control_state(app, msg->value);
+
+    case STREAM_CTL_CAMERA:
+        return stream_control_camera(app, msg->camera, msg->value);
+
+    case STREAM_CTL_BITRATE:
+        return stream_control_bitrate(app, msg->camera, msg->value);
+
+    case STREAM_CTL_RECORD_PATH:
+        return stream_control_record_path(app, msg->path);
 
-        app->stream_appsrc[i] = NULL;
+    case STREAM_CTL_TRACK:
+        /* ...track is switched by the application thread once main loop exits */
+        CHK_ERR(!stream_control_switching(app), -EBUSY);
+        (msg->value > 0 ? app_next_track(app) : msg->value < 0 ? app_prev_track(app) : app_restart_track(app));
+        return 0;
+
+    case STREAM_CTL_STATS:
+        return 0;
+
+    default:
+        TRACE(ERROR, _b("unknown control request %u"), msg->type);
+        return -EINVAL;
     }
+}
 
-    app->stream_state = DISABLED;
+/* ...request passed to executor */
+typedef struct stream_control_work
+{
+    /* ...application handle */
+    app_data_t             *app;
 
-    return 0;
+    /* ...connection to respond to (duplicated descriptor; -1 - no response) */
+    int                     fd;
+
+    /* ...request message */
+    stream_control_msg_t    msg;
+
+}   stream_control_work_t;
+
+/* ...execute request and send response (executor thread) */
+static void stream_control_execute(gpointer data, gpointer user_data)
+{
+    stream_control_work_t  *w = data;
+    app_data_t             *app = w->app;
+    stream_control_reply_t  reply;
+
+    memset(&reply, 0, sizeof(reply));
+
+    pthread_mutex_lock(&app->stream_lock);
+    reply.status = stream_control_request(app, &w->msg);
+    stream_control_stats(app, &reply);
+    pthread_mutex_unlock(&app->stream_lock);
+
+    /* ...connection hang-up is handled by the main loop */
+    if (w->fd >= 0)
+    {
+        if (send(w->fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+        {
+            TRACE(ERROR, _x("control response failed: %m"));
+        }
+
+        close(w->fd);
+    }
+
+    free(w);
 }
 
-/* ...create streaming instance */
-int stream_pipeline_push_buffer(app_data_t *app, int i, GstPipeline* pipeline, GstBuffer* buffer)
+/* ...queue request for execution (responses are sent over a connection, if any) */
+static int stream_control_submit(app_data_t *app, stream_control_msg_t *msg, int fd)
 {
-    int ret;
-    
-    ret = gst_app_src_push_buffer(app->stream_appsrc[i], buffer);
+    stream_control_work_t  *w;
 
-    if (ret != GST_FLOW_OK)
+    CHK_ERR(w = malloc(sizeof(*w)), -ENOMEM);
+
+    /* ...connection may get closed before response is sent */
+    if ((w->fd = fd) >= 0 && (w->fd = dup(fd)) < 0)
     {
-        TRACE(ERROR, _b("camera-%d: failed to push  buffer in streamer"), i);
-        return -1;
+        TRACE(ERROR, _x("failed to duplicate control connection: %m"));
+        free(w);
+        return -errno;
     }
 
-    TRACE(BUFFER, _b("camera-%d: pushed  buffer in streamer"), i);
+    w->app = app;
+    w->msg = *msg;
+
+    /* ...single executor thread keeps requests ordered */
+    g_thread_pool_push(__stream_control_pool, w, NULL);
 
     return 0;
 }
 
+/* ...control channel data (message queue, listening socket or connection) */
+typedef struct stream_control_channel
+{
+    /* ...application handle */
+    app_data_t         *app;
+
+    /* ...main loop source of the channel */
+    fd_source_t        *source;
+
+}   stream_control_channel_t;
 
-/* ...decoding thread */
-static void * stream_control_thread(void *arg)
+/* ...attach channel to the main loop (descriptor ownership is taken) */
+static stream_control_channel_t * stream_control_channel(app_data_t *app, int fd, GSourceFunc func)
 {
-    app_data_t      *app = arg;
-    struct mq_attr attr;
-    mqd_t qd;
+    stream_control_channel_t   *ch;
 
-    app->stream_state = DISABLED;
-    app->stream_frame_count = -1; /* infinite */
+    CHK_ERR(ch = malloc(sizeof(*ch)), (close(fd), errno = ENOMEM, NULL));
 
-    if (!app->stream_file)
+    ch->app = app;
+    ch->source = fd_source_create_fd(fd, G_PRIORITY_DEFAULT, func, ch, free, g_main_loop_get_context(app->loop));
+
+    if (ch->source == NULL)
     {
-        app->stream_file = RECORDING_FILENAME;
+        free(ch);
+        errno = ENOMEM;
+        return NULL;
     }
 
-    /* initialize the queue attributes */
-    attr.mq_flags = 0;
-    attr.mq_maxmsg = 1;
-    attr.mq_msgsize = sizeof(u8);
-    attr.mq_curmsgs = 0;
+    fd_source_resume(ch->source);
 
-    qd = mq_open(STREAM_CONTROL_MQ, O_RDONLY  | O_CREAT , 0644, &attr);
-    if (qd == -1)
+    return ch;
+}
+
+/* ...control socket connection is readable */
+static gboolean stream_control_client(gpointer data)
+{
+    stream_control_channel_t   *ch = data;
+    app_data_t                 *app = ch->app;
+    int                         fd = fd_source_get_fd(ch->source);
+    stream_control_msg_t        msg;
+    stream_control_reply_t      reply;
+    ssize_t                     n;
+
+    /* ...zero-length read is a hang-up; connection source gets destroyed */
+    if ((n = recv(fd, &msg, sizeof(msg), MSG_DONTWAIT)) <= 0)
     {
-        BUG(1, _b("Failed to open control channel"));
+        return (n < 0 && (errno == EAGAIN || errno == EINTR));
     }
 
-    /* Open posix mq */
-    while (1)
+    memset(&reply, 0, sizeof(reply));
+
+    /* ...short messages are rejected; path argument is optional */
+    if (n < (ssize_t)offsetof(stream_control_msg_t, path))
+    {
+        reply.status = -EINVAL;
+    }
+    else
     {
-        ssize_t len;
-        u8 cmd;
-        
-        len = mq_receive(qd, (char*)&cmd, sizeof(u8), NULL);
+        (n < (ssize_t)sizeof(msg) ? msg.path[n - offsetof(stream_control_msg_t, path)] = '\0' : 0);
 
-        if (len > 0)
+        /* ...response is sent by the executor once request completes */
+        if ((reply.status = stream_control_submit(app, &msg, fd)) == 0)
         {
-            pthread_mutex_lock(&app->lock);
+            return TRUE;
+        }
+    }
 
-            if (app->stream_state == cmd)
-            {
-                pthread_mutex_unlock(&app->lock);
-                continue;
-            }
+    if (send(fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+        TRACE(ERROR, _x("control response failed: %m"));
+        return FALSE;
+    }
 
-            switch (cmd)
-            {
-            case DISABLED:
-                /* Disable streaming and recording */
-                TRACE(INFO, _b("Disable all"));
-                stream_pipeline_stop(app);
-                break;
-            case STREAMING:
-            case RECORDING:
-            case COMBINED:
-
-                TRACE(INFO, _b("Destroy pipeline"));
-
-                if (app->stream_state != DISABLED)
-                {
-                    stream_pipeline_stop(app);
-                }
-
-                TRACE(INFO, _b("Start streaming: command %d"), cmd);
-
-                if (stream_pipeline_start(app, cmd) == NULL)
-                {
-                    TRACE(ERROR, _b("stream failed"));
-                }
-
-                break;
-            }
-            pthread_mutex_unlock(&app->lock);
-        }
-        else if (!len)
-        {
-            TRACE(ERROR, _b("EOF in control channel"));
-        }
-        else if (errno == EINTR || errno == EAGAIN)
-        {
-            /* todo: rework */
-            usleep(1*1000);
-        }
-        else
-        {
-            TRACE(ERROR, _b("Unknown error in stream control channel"));
-        }
+    return TRUE;
+}
+
+/* ...control socket connection request */
+static gboolean stream_control_accept(gpointer data)
+{
+    stream_control_channel_t   *ch = data;
+    int                         fd;
+
+    if ((fd = accept4(fd_source_get_fd(ch->source), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0)
+    {
+        TRACE(ERROR, _x("control connection failed: %m"));
+        return TRUE;
+    }
+
+    if (stream_control_channel(ch->app, fd, stream_control_client) == NULL)
+    {
+        TRACE(ERROR, _x("failed to attach control connection: %m"));
+        return TRUE;
+    }
+
+    TRACE(INFO, _b("control connection accepted"));
+
+    return TRUE;
+}
+
+/* ...legacy single-byte commands from message queue */
+static gboolean stream_control_mq(gpointer data)
+{
+    stream_control_channel_t   *ch = data;
+    stream_control_msg_t        msg;
+    u8                          cmd;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = STREAM_CTL_STATE;
+
+    /* ...queue is non-blocking; drain whatever has been posted */
+    while (mq_receive((mqd_t)fd_source_get_fd(ch->source), (char *)&cmd, sizeof(u8), NULL) > 0)
+    {
+        msg.value = cmd;
+        stream_control_submit(ch->app, &msg, -1);
+    }
+
+    return TRUE;
+}
+
+/* ...open control socket */
+static int stream_control_socket(const char *path)
+{
+    struct sockaddr_un  addr;
+    int                 fd;
+
+    CHK_ERR(strlen(path) < sizeof(addr.sun_path), -ENAMETOOLONG);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    CHK_ERR((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) >= 0, -errno);
+
+    /* ...stale socket of a previous run is replaced */
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0)
+    {
+        TRACE(ERROR, _x("failed to open control socket '%s': %m"), path);
+        close(fd);
+        return -errno;
     }
 
-    return (void *)(intptr_t)-errno;
+    return fd;
 }
 
 static gchar*
@@ -425,13 +2155,22 @@ out:
 /* ...Start network stream control */
 int stream_pipeline_control_start(app_data_t *app)
 {
-    pthread_attr_t  attr;
-    int             r;
+    struct mq_attr  attr;
+    mqd_t           qd;
+    int             fd;
     int i;
 
+    /* ...channels are attached to the main loop once and serve all tracks */
+    if (app->stream_control)
+    {
+        return 0;
+    }
+
     app->stream_ip = __stream_ip;
     app->stream_base_port = __stream_base_port;
-    app->stream_file = __stream_file;
+    app->stream_file = __stream_file ? : RECORDING_FILENAME;
+    app->stream_state = DISABLED;
+    app->stream_frame_count = -1; /* infinite */
 
     if (!app->stream_ip || app->stream_base_port == 0)
     {
@@ -439,7 +2178,10 @@ int stream_pipeline_control_start(app_data_t *app)
         return -1;
     }
 
-    for (i = 0; i < VSP_DEVICE_NUMBER; i++)
+    /* ...pick encoder back-end available in this system */
+    CHK_ERR(__stream_backend = stream_backend_select(__stream_encoder), -errno);
+
+    for (i = 0; __stream_backend->vsp && i < VSP_DEVICE_NUMBER; i++)
     {
         vsp_devices[2 * i] = find_v4l2_for_media_device(media_devices[i], "rpf.0");
         vsp_devices[2 * i + 1] = find_v4l2_for_media_device(media_devices[i], "wpf.0");
@@ -450,24 +2192,65 @@ int stream_pipeline_control_start(app_data_t *app)
               vsp_devices[2 * i + 1]);
     }
 
-    /* ...initialize thread attributes (joinable, 128KB stack) */
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setstacksize(&attr, 128 << 10);
+    __stream_queued_quark = g_quark_from_static_string("sv-stream-queued");
+
+    /* ...exported camera buffers are passed to VSP without copying */
+    if (__stream_dmabuf && __stream_backend->vsp)
+    {
+        __stream_allocator = gst_dmabuf_allocator_new();
+    }
+
+    /* ...closed segments are flushed from a dedicated thread */
+    if (__record_prealloc && (__record_segment_time || __record_segment_size))
+    {
+        __segment_pool = g_thread_pool_new(stream_segment_closed, NULL, 1, FALSE, NULL);
+    }
+
+    /* ...initialize the queue attributes */
+    attr.mq_flags = 0;
+    attr.mq_maxmsg = 1;
+    attr.mq_msgsize = sizeof(u8);
+    attr.mq_curmsgs = 0;
+
+    /* ...message queue descriptor is pollable; commands are read by the main loop */
+    qd = mq_open(STREAM_CONTROL_MQ, O_RDONLY | O_NONBLOCK | O_CREAT, 0644, &attr);
+    if (qd == (mqd_t)-1)
+    {
+        TRACE(ERROR, _x("Failed to open control channel: %m"));
+        return -errno;
+    }
+
+    /* ...control requests are executed in order outside of the main loop */
+    __stream_control_pool = g_thread_pool_new(stream_control_execute, NULL, 1, FALSE, NULL);
 
-    r = pthread_create(&app->stream_control, &attr, stream_control_thread, app);
-    pthread_attr_destroy(&attr);
+    CHK_ERR(stream_control_channel(app, (int)qd, stream_control_mq), -errno);
 
-    return CHK_API(r);
+    /* ...message queue stays attached even if socket cannot be opened */
+    app->stream_control = 1;
+
+    /* ...typed requests with responses */
+    if (__stream_control_socket)
+    {
+        CHK_API(fd = stream_control_socket(__stream_control_socket));
+        CHK_ERR(stream_control_channel(app, fd, stream_control_accept), -errno);
+
+        TRACE(INIT, _b("control socket '%s' opened"), __stream_control_socket);
+    }
+
+    return 0;
 }
 
 /* ...create streaming instance */
 int stream_pipeline_destroy(app_data_t *app)
 {
+    pthread_mutex_lock(&app->stream_lock);
+
     if (app->stream_state != DISABLED)
     {
         stream_pipeline_stop(app);
     }
 
+    pthread_mutex_unlock(&app->stream_lock);
+
     return 0;
 }
@@ -65,9 +65,549 @@ static window_info_t app_main_info =
 };
 
 /*******************************************************************************
- * Render queue access helpers
+ * Benchmark statistics
  ******************************************************************************/
 
+/* ...account buffer received from camera (called with a queue lock held) */
+static inline void sview_bench_input(app_data_t *app, int i, GstBuffer *buffer)
+{
+    app_bench_t    *bench = &app->bench[i];
+    guint64         seq = GST_BUFFER_OFFSET(buffer);
+
+    bench->received++;
+
+    /* ...detect gaps in frame sequence numbers if camera provides them */
+    if (seq != GST_BUFFER_OFFSET_NONE)
+    {
+        (bench->started && seq > bench->sequence + 1 ? bench->lost += seq - bench->sequence - 1 : 0);
+        bench->sequence = seq, bench->started = 1;
+    }
+}
+
+/* ...frame time samples comparison */
+static int __frame_time_cmp(const void *a, const void *b)
+{
+    u32     x = *(const u32 *)a, y = *(const u32 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* ...output frame processing time percentiles and reset samples */
+static void sview_bench_frame_time(app_data_t *app)
+{
+    u32    *t = app->frame_time;
+    u32     n = MIN(app->frame_count, APP_BENCH_FRAMES);
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    qsort(t, n, sizeof(*t), __frame_time_cmp);
+
+    TRACE(1, _b("frame time: p50=%.2f ms, p90=%.2f ms, p99=%.2f ms, max=%.2f ms (%u of %u frames)"),
+          t[(n - 1) * 50 / 100] / 1e+03,
+          t[(n - 1) * 90 / 100] / 1e+03,
+          t[(n - 1) * 99 / 100] / 1e+03,
+          t[n - 1] / 1e+03,
+          n, app->frame_count);
+
+    app->frame_count = 0;
+}
+
+/* ...account rendered buffers set and output report periodically */
+static void sview_bench_render(app_data_t *app, GstBuffer **buffers, u32 frame_time)
+{
+    GstClock       *clock = GST_ELEMENT_CLOCK(app->pipe);
+    GstClockTime    now;
+    u32             ts = get_time_usec();
+    u32             delta;
+    uint32_t        hits, misses;
+    uint32_t        period, present_avg, present_max;
+    int             i, n, presented;
+
+    /* ...clock is not available until pipeline gets running */
+    if (clock == NULL)
+    {
+        return;
+    }
+
+    now = gst_clock_get_time(clock);
+
+    pthread_mutex_lock(&app->lock);
+
+    /* ...keep most recent frame processing time samples */
+    app->frame_time[app->frame_count++ % APP_BENCH_FRAMES] = frame_time;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        app_bench_t    *bench = &app->bench[i];
+        GstClockTime    dts = GST_BUFFER_DTS(buffers[i]);
+
+        bench->rendered++;
+
+        /* ...decoding timestamp is a moment buffer has been dequeued from camera */
+        if (GST_CLOCK_TIME_IS_VALID(dts) && now > dts)
+        {
+            bench->latency_acc += now - dts;
+            (bench->latency_max < now - dts ? bench->latency_max = now - dts : 0);
+        }
+    }
+
+    /* ...check if report is due */
+    if (app->bench_ts == 0)
+    {
+        app->bench_ts = ts;
+    }
+    else if ((delta = ts - app->bench_ts) >= (u32)__benchmark_interval * 1000000U)
+    {
+        for (i = 0; i < CAMERAS_NUMBER; i++)
+        {
+            app_bench_t    *bench = &app->bench[i];
+            u32             total = bench->received + bench->lost;
+            u32             skipped = __atomic_exchange_n(&bench->skipped, 0, __ATOMIC_RELAXED);
+
+            TRACE(1, _b("camera-%d: in=%.1f fps, out=%.1f fps, latency avg=%.2f ms, max=%.2f ms, lost=%u (%.2f%%), skipped=%u (%.2f%%)"),
+                  i,
+                  bench->received * 1e+06 / delta,
+                  bench->rendered * 1e+06 / delta,
+                  (bench->rendered ? bench->latency_acc / 1e+06 / bench->rendered : 0.0),
+                  bench->latency_max / 1e+06,
+                  bench->lost,
+                  (total ? bench->lost * 100.0 / total : 0.0),
+                  skipped,
+                  (bench->received ? skipped * 100.0 / bench->received : 0.0));
+
+            /* ...reset counters but keep sequence tracking state (skipped counter is taken atomically) */
+            bench->received = bench->rendered = bench->lost = 0;
+            bench->latency_acc = bench->latency_max = 0;
+        }
+
+        /* ...output frame processing time distribution */
+        sview_bench_frame_time(app);
+
+        /* ...output submission-to-presentation (or frame callback) latency if compositor reports it */
+        if ((n = window_present_stats(app->window, &period, &present_avg, &present_max, &presented)) > 0)
+        {
+            TRACE(1, _b("%s: refresh=%.2f ms, latency avg=%.2f ms, max=%.2f ms (%d frames)"),
+                  (presented ? "present" : "frame-callback"),
+                  period / 1e+03, present_avg / 1e+03, present_max / 1e+03, n);
+        }
+
+        /* ...output dmabuf import cache statistics (accumulated) */
+        texture_cache_stats(&hits, &misses);
+
+        if (hits | misses)
+        {
+            TRACE(1, _b("dmabuf import cache: hits=%u, misses=%u"), hits, misses);
+        }
+
+        /* ...output cameras synchronization statistics */
+        if (__sync_window)
+        {
+            TRACE(1, _b("sync: window=%d ms, misses=%u/%u (%.2f%%)"),
+                  __sync_window, app->sync_miss, app->sync_total,
+                  (app->sync_total ? app->sync_miss * 100.0 / app->sync_total : 0.0));
+
+            app->sync_miss = app->sync_total = 0;
+        }
+
+        /* ...output frames dropped before encoding */
+        for (i = 0; i < CAMERAS_NUMBER && app->stream_state != DISABLED; i++)
+        {
+            u32     total = app->stream_pushed[i] + app->stream_dropped[i];
+
+            TRACE(1, _b("stream camera-%d: queued=%u, dropped=%u (%.2f%%)"),
+                  i, app->stream_pushed[i], app->stream_dropped[i],
+                  (total ? app->stream_dropped[i] * 100.0 / total : 0.0));
+
+            app->stream_pushed[i] = app->stream_dropped[i] = 0;
+        }
+
+        app->bench_ts = ts;
+    }
+
+    pthread_mutex_unlock(&app->lock);
+}
+
+/*******************************************************************************
+ * Performance HUD
+ ******************************************************************************/
+
+/* ...account buffer received from camera */
+static inline void sview_hud_input(app_data_t *app, int i, GstBuffer *buffer)
+{
+    app_hud_t      *hud = &app->hud[i];
+    GstClock       *clock = GST_ELEMENT_CLOCK(app->pipe);
+    GstClockTime    dts = GST_BUFFER_DTS(buffer);
+    GstClockTime    now;
+
+    __atomic_add_fetch(&hud->received, 1, __ATOMIC_RELAXED);
+
+    /* ...decoding timestamp is a moment buffer has been dequeued from camera */
+    if (clock && GST_CLOCK_TIME_IS_VALID(dts) && (now = gst_clock_get_time(clock)) > dts)
+    {
+        __atomic_add_fetch(&hud->decode_acc, (u32)((now - dts) / 1000), __ATOMIC_RELAXED);
+    }
+}
+
+/* ...account texture content upload */
+static inline void sview_hud_upload(app_data_t *app, int i, texture_data_t *texture)
+{
+    app_hud_t      *hud = &app->hud[i];
+
+    __atomic_add_fetch(&hud->uploads, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hud->upload_acc, texture->upload_time, __ATOMIC_RELAXED);
+}
+
+/* ...restart statistics collection (rendering thread) */
+static void sview_hud_reset(app_data_t *app, u32 ts)
+{
+    int     i;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        app_hud_t  *hud = &app->hud[i];
+
+        __atomic_store_n(&hud->received, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&hud->decode_acc, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&hud->uploads, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&hud->upload_acc, 0, __ATOMIC_RELAXED);
+    }
+
+    app->hud_frames = app->hud_engine = app->hud_gpu = app->hud_gpu_num = app->hud_swap = 0;
+    app->hud_text[0] = '\0';
+    app->hud_ts = ts;
+}
+
+/* ...account rendering stages timing and refresh HUD text periodically */
+static void sview_hud_update(app_data_t *app, float fps, u32 engine, u32 swap)
+{
+    char   *p = app->hud_text;
+    char   *end = p + sizeof(app->hud_text);
+    u32     ts = get_time_usec();
+    u32     delta, n;
+    int     i;
+
+    /* ...HUD has just been enabled */
+    if (app->hud_ts == 0)
+    {
+        sview_hud_reset(app, ts);
+        return;
+    }
+
+    app->hud_frames++, app->hud_engine += engine, app->hud_swap += swap;
+
+    /* ...GPU results arrive with a few frames delay */
+    if (app->gpu_timer)
+    {
+        app->hud_gpu_num += gpu_timer_collect(app->gpu_timer, &app->hud_gpu);
+    }
+
+    if ((delta = ts - app->hud_ts) < APP_HUD_INTERVAL)
+    {
+        return;
+    }
+
+    n = app->hud_frames;
+
+    p += snprintf(p, end - p, "%.1f FPS  engine %.2f ms", fps, app->hud_engine / 1e+03 / n);
+
+    if (app->hud_gpu_num)
+    {
+        p += snprintf(p, end - p, " (GPU %.2f ms)", app->hud_gpu / 1e+03 / app->hud_gpu_num);
+    }
+
+    p += snprintf(p, end - p, "  swap %.2f ms", app->hud_swap / 1e+03 / n);
+
+    /* ...fetch and reset producers counters */
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        app_hud_t  *hud = &app->hud[i];
+        u32         received = __atomic_exchange_n(&hud->received, 0, __ATOMIC_RELAXED);
+        u32         decode = __atomic_exchange_n(&hud->decode_acc, 0, __ATOMIC_RELAXED);
+        u32         uploads = __atomic_exchange_n(&hud->uploads, 0, __ATOMIC_RELAXED);
+        u32         upload = __atomic_exchange_n(&hud->upload_acc, 0, __ATOMIC_RELAXED);
+
+        p += snprintf(p, end - p, "\ncamera-%d: %.1f fps  latency %.2f ms  queue %u  upload %.2f ms",
+                      i,
+                      received * 1e+06 / delta,
+                      (received ? decode / 1e+03 / received : 0.0),
+                      __atomic_load_n(&hud->depth, __ATOMIC_RELAXED),
+                      (uploads ? upload / 1e+03 / uploads : 0.0));
+    }
+
+    app->hud_frames = app->hud_engine = app->hud_gpu = app->hud_gpu_num = app->hud_swap = 0;
+    app->hud_ts = ts;
+}
+
+/*******************************************************************************
+ * Cameras synchronization
+ ******************************************************************************/
+
+/* ...buffer capture timestamp (presentation timestamp if available) */
+static inline GstClockTime __buffer_ts(GstBuffer *buffer)
+{
+    return (GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer));
+}
+
+/* ...select a set of buffers to render (called with a queue lock held) */
+static inline int sview_sync_select(app_data_t *app, GstBuffer **buf)
+{
+    GstClockTime    ref = GST_CLOCK_TIME_NONE, lo, hi, t;
+    int             valid = 1;
+    u32             ts;
+    int             i;
+
+    /* ...take the most actual buffers from all cameras by default */
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        buf[i] = g_queue_peek_tail(&app->render[i]);
+
+        /* ...buffer must be available */
+        if (buf[i] == NULL)
+        {
+            TRACE(ERROR, _x("No buffer from camera %d"), i);
+            return 0;
+        }
+
+        /* ...reference time is the newest frame of the most lagging camera */
+        t = __buffer_ts(buf[i]);
+        if (!GST_CLOCK_TIME_IS_VALID(t))
+        {
+            valid = 0;
+        }
+        else if (!GST_CLOCK_TIME_IS_VALID(ref) || t < ref)
+        {
+            ref = t;
+        }
+    }
+
+    /* ...synchronization is disabled or impossible (no timestamps) */
+    if (__sync_window == 0 || !valid)
+    {
+        return 1;
+    }
+
+    lo = hi = ref;
+
+    /* ...for every camera find the frame closest to the reference time */
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        GList          *item;
+        GstClockTimeDiff diff, best = G_MAXINT64;
+
+        for (item = app->render[i].head; item; item = item->next)
+        {
+            /* ...frames without capture time cannot be matched; newest one is kept by default */
+            if (!GST_CLOCK_TIME_IS_VALID(t = __buffer_ts(item->data)))
+            {
+                continue;
+            }
+
+            diff = GST_CLOCK_DIFF(t, ref);
+            diff = ABS(diff);
+
+            /* ...queue is ordered by capture time; stop when distance starts growing */
+            if (diff > best)
+            {
+                break;
+            }
+
+            best = diff, buf[i] = item->data;
+        }
+
+        t = __buffer_ts(buf[i]);
+        (t < lo ? lo = t : 0), (t > hi ? hi = t : 0);
+    }
+
+    /* ...check if selected frames fit synchronization window */
+    if (hi - lo <= (GstClockTime)__sync_window * GST_MSECOND)
+    {
+        app->sync_total++, app->sync_ts = 0;
+        return 1;
+    }
+
+    /* ...wait for a better set if policy allows */
+    if (__sync_wait > 0)
+    {
+        ts = get_time_usec();
+
+        if (app->sync_ts == 0)
+        {
+            /* ...start waiting */
+            app->sync_ts = ts;
+            return 0;
+        }
+        else if (ts - app->sync_ts < (u32)__sync_wait * 1000U)
+        {
+            /* ...still within waiting interval */
+            return 0;
+        }
+    }
+
+    /* ...use best available set */
+    app->sync_total++, app->sync_miss++, app->sync_ts = 0;
+
+    TRACE(DEBUG, _b("sync miss: frames spread %.2f ms (window %d ms, misses: %u/%u)"),
+          (double)(hi - lo) / GST_MSECOND, __sync_window, app->sync_miss, app->sync_total);
+
+    return 1;
+}
+
+/*******************************************************************************
+ * CPU-upload textures cache
+ ******************************************************************************/
+
+#if defined (EGL_HAS_IMG_EXTERNAL_EXT)
+/* ...texture wraps buffer memory - keep it per pool buffer */
+#define __texture_cache_key(data)       (data)
+#else
+/* ...content is uploaded on every frame - single texture per camera is enough */
+#define __texture_cache_key(data)       NULL
+#endif
+
+/* ...get texture for the mapped buffer content (called with a queue lock held) */
+static texture_data_t * sview_texture_cache_get(app_data_t *app, int i, vsink_meta_t *meta)
+{
+    app_texture_cache_t    *cache = app->tex_cache[i];
+    app_texture_cache_t    *e, *victim = cache;
+    const void             *key = __texture_cache_key(meta->plane[0]);
+    int                     j;
+
+    for (j = 0, e = cache; j < APP_TEXTURE_CACHE_SIZE; j++, e++)
+    {
+        if (e->tex == NULL)
+        {
+            /* ...prefer free slot for replacement */
+            (victim->tex != NULL ? victim = e : 0);
+            continue;
+        }
+
+        if (e->key == key && e->width == meta->width && e->height == meta->height && e->format == meta->format)
+        {
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+            /* ...re-upload buffer content into existing texture */
+            memcpy(e->tex->data, meta->plane, sizeof(e->tex->data));
+            texture_update(e->tex);
+
+            if (app->flags & APP_FLAG_HUD)
+            {
+                sview_hud_upload(app, i, e->tex);
+            }
+#endif
+            e->used = ++app->tex_cache_seq;
+            return e->tex;
+        }
+
+        /* ...track least recently used entry */
+        (victim->tex != NULL && e->used < victim->used ? victim = e : 0);
+    }
+
+    /* ...no matching texture; replace the victim */
+    if (victim->tex != NULL)
+    {
+        TRACE(DEBUG, _b("camera-%d: evict texture %p (key: %p)"), i, victim->tex, victim->key);
+        texture_destroy(victim->tex);
+        victim->tex = NULL;
+    }
+
+    if ((victim->tex = texture_create(meta)) == NULL)
+    {
+        return NULL;
+    }
+
+    victim->key = key;
+    victim->width = meta->width;
+    victim->height = meta->height;
+    victim->format = meta->format;
+    victim->used = ++app->tex_cache_seq;
+
+    TRACE(DEBUG, _b("camera-%d: cached texture %p (key: %p)"), i, victim->tex, key);
+
+    return victim->tex;
+}
+
+/* ...destroy all cached textures */
+static void sview_texture_cache_flush(app_data_t *app)
+{
+    int     i, j;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        for (j = 0; j < APP_TEXTURE_CACHE_SIZE; j++)
+        {
+            app_texture_cache_t    *e = &app->tex_cache[i][j];
+
+            if (e->tex)
+            {
+                texture_destroy(e->tex);
+                e->tex = NULL;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Render mailboxes
+ ******************************************************************************/
+
+/* ...take latest buffers if every camera has one pending (rendering thread) */
+static inline int sview_mailbox_take(app_data_t *app, GstBuffer **buf)
+{
+    int     i;
+
+    /* ...only renderer empties mailboxes; pending buffer cannot disappear */
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        if (__atomic_load_n(&app->mailbox[i], __ATOMIC_ACQUIRE) == NULL)
+        {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        buf[i] = __atomic_exchange_n(&app->mailbox[i], NULL, __ATOMIC_ACQ_REL);
+    }
+
+    return 1;
+}
+
+/* ...drop pending mailbox buffers */
+static void sview_mailbox_drain(app_data_t *app)
+{
+    GstBuffer  *buffer;
+    int         i;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        if ((buffer = __atomic_exchange_n(&app->mailbox[i], NULL, __ATOMIC_ACQ_REL)) != NULL)
+        {
+            TRACE(BUFFER, _b("camera-%d: dropping buffer: %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+            gst_buffer_unref(buffer);
+        }
+    }
+}
+
+/* ...release frame set kept on screen while paused */
+static void sview_idle_release(app_data_t *app)
+{
+    int         i;
+
+    for (i = 0; app->held[0] && i < CAMERAS_NUMBER; i++)
+    {
+        if (app->held_maps[i].memory)
+        {
+            gst_buffer_unmap(app->held[i], &app->held_maps[i]);
+            memset(&app->held_maps[i], 0, sizeof(app->held_maps[i]));
+        }
+
+        TRACE(BUFFER, _b("camera-%d: release held buffer %p, refcount=%d"), i, app->held[i], GST_MINI_OBJECT_REFCOUNT(app->held[i]));
+        gst_buffer_unref(app->held[i]), app->held[i] = NULL;
+    }
+}
+
 /* ...pop buffers from a render queue */
 static inline int sview_pop_buffers(app_data_t *app,
                                     GstBuffer **buf,
@@ -75,13 +615,12 @@ static inline int sview_pop_buffers(app_data_t *app,
                                     GLuint *t,
                                     void **planes,
                                     s64 *ts,
-                                    char *need_tex_destroy,
                                     GstMapInfo *buffer_maps)
 {
-    int     i;
+    int     i, j;
     int     ready;
 
-    /* ...lock access to internal data */
+    /* ...lock access to internal data (not contended by producers in mailbox mode) */
     pthread_mutex_lock(&app->lock);
 
     /* ...check for a termination request */
@@ -98,15 +637,29 @@ static inline int sview_pop_buffers(app_data_t *app,
             }
         }
 
+        sview_mailbox_drain(app);
+        sview_idle_release(app);
+
+        /* ...stream parameters may change; drop cached textures */
+        sview_texture_cache_flush(app);
+
         TRACE(DEBUG, _b("purged rendering queue"));
 
         /* ...mark we have no buffers to draw */
         ready = 0;
     }
-    else if ((app->frames & ((1 << CAMERAS_NUMBER) - 1)) == 0)
+    else if (__render_mailbox ? sview_mailbox_take(app, buf) : (app->frames & ((1 << CAMERAS_NUMBER) - 1)) == 0)
     {
         s64     ts_acc = 0;
 
+        /* ...select synchronized set of frames (mailboxes always hold the newest) */
+        if (!__render_mailbox && !sview_sync_select(app, buf))
+        {
+            TRACE(DEBUG, _b("waiting for synchronized frames set"));
+            pthread_mutex_unlock(&app->lock);
+            return 0;
+        }
+
         /* ...collect the textures corresponding to the cameras */
         for (i = 0; i < CAMERAS_NUMBER; i++)
         {
@@ -115,16 +668,11 @@ static inline int sview_pop_buffers(app_data_t *app,
             vsink_meta_t   *meta;
             texture_data_t *texture;
 
-            /* ...buffer must be available */
-            if (g_queue_is_empty(queue))
-            {
-                TRACE(ERROR, _x("No buffer from camera %d"), i);
-                pthread_mutex_unlock(&app->lock);
-                return 0;
-            }
+            /* ...use buffer selected by synchronizer */
+            buffer = buf[i];
 
-            /* ...retrieve last (most actual) buffer */
-            buf[i] = buffer = g_queue_peek_tail(queue);
+            /* ...sample queue depth for performance HUD */
+            __atomic_store_n(&app->hud[i].depth, (__render_mailbox ? 1 : g_queue_get_length(queue)), __ATOMIC_RELAXED);
             meta = gst_buffer_get_vsink_meta(buffer);
             TRACE(BUFFER, _b("camera-%d received buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
 
@@ -134,6 +682,11 @@ static inline int sview_pop_buffers(app_data_t *app,
                 texture = meta->priv;
                 TRACE(DEBUG, _b("meta present"));
             }
+            else if ((app->flags & APP_FLAG_PAUSE) && app->held[0])
+            {
+                /* ...set is dropped while paused; do not upload it over (or evict) frozen textures */
+                texture = app->held_tex[i];
+            }
             else
             {
                 /* ...use image info from VAAPI meta */
@@ -162,17 +715,31 @@ static inline int sview_pop_buffers(app_data_t *app,
                 tmp_meta.plane[2] = buffer_maps[i].data + (width * height) / 4 * 5;
                 tmp_meta.width = width;
                 tmp_meta.height = height;
-                /* ...create texture using data from the buffer */
-                texture = texture_create(&tmp_meta);
+                /* ...get cached texture and upload buffer content */
+                texture = sview_texture_cache_get(app, i, &tmp_meta);
                 if (texture == NULL)
                 {
                     TRACE(ERROR, _x("failed to create texture"));
+
+                    /* ...release all buffers mapped so far */
+                    for (; i >= 0; i--)
+                    {
+                        if (buffer_maps[i].memory)
+                        {
+                            gst_buffer_unmap(buf[i], &buffer_maps[i]);
+                            memset(&buffer_maps[i], 0, sizeof(buffer_maps[i]));
+                        }
+                    }
+
+                    /* ...buffers taken from mailboxes are dropped */
+                    for (j = 0; __render_mailbox && j < CAMERAS_NUMBER; j++)
+                    {
+                        gst_buffer_unref(buf[j]);
+                    }
+
                     pthread_mutex_unlock(&app->lock);
                     return 0;
                 }
-
-                /* ...notify caller that texture must be freed after drawing */
-                *need_tex_destroy = 1;
             }
 
             tex[i] = texture;
@@ -180,12 +747,16 @@ static inline int sview_pop_buffers(app_data_t *app,
             planes[i] = texture->data[0];
 
             /* ...update timestamp accumulator */
-            ts_acc += GST_BUFFER_DTS(buffer);
+            ts_acc += __buffer_ts(buffer);
 
             /* ...drop all "previous" buffers */
-            while (g_queue_peek_head(queue) != buffer)
+            while (!__render_mailbox && g_queue_peek_head(queue) != buffer)
             {
                 GstBuffer *tmp = g_queue_pop_head(queue);
+
+                /* ...account buffers that never reached the screen (shared with mailbox path) */
+                __atomic_add_fetch(&app->bench[i].skipped, 1, __ATOMIC_RELAXED);
+
                 gst_buffer_unref(tmp);
                 TRACE(BUFFER, _b("camera-%d dropping buffer %p, refcount=%d"), i, tmp, GST_MINI_OBJECT_REFCOUNT(tmp));
             }
@@ -213,6 +784,18 @@ static inline void sview_release_buffers(app_data_t *app, GstBuffer **buffers)
 {
     int     i;
 
+    /* ...buffers taken from mailboxes are owned by renderer */
+    if (__render_mailbox)
+    {
+        for (i = 0; i < CAMERAS_NUMBER; i++)
+        {
+            TRACE(BUFFER, _b("camera-%d release buffer %p, refcount=%d"), i, buffers[i], GST_MINI_OBJECT_REFCOUNT(buffers[i]));
+            gst_buffer_unref(buffers[i]);
+        }
+
+        return;
+    }
+
     pthread_mutex_lock(&app->lock);
 
     /* ...drop the buffers - they are heads of the rendering queues */
@@ -227,57 +810,246 @@ static inline void sview_release_buffers(app_data_t *app, GstBuffer **buffers)
         /* ...remove head of the queue */
         buffer = g_queue_pop_head(queue);
 
-        /* ...buffer must be at the head of the queue */
-        BUG(buffers[i] != buffer, _x("invalid queue head: %p != %p"), buffers[i], buffer);
+        /* ...buffer must be at the head of the queue */
+        BUG(buffers[i] != buffer, _x("invalid queue head: %p != %p"), buffers[i], buffer);
+
+        TRACE(BUFFER, _b("camera-%d release buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+
+        /* ...return buffer to a pool */
+        gst_buffer_unref(buffer);
+
+        /* ...check if queue gets empty */
+        (g_queue_is_empty(queue) ? app->frames ^= 1 << i : 0);
+    }
+
+    pthread_mutex_unlock(&app->lock);
+}
+
+/*******************************************************************************
+ * Interface exposed to the camera backend
+ ******************************************************************************/
+
+/* ...deallocate texture data */
+static void __destroy_sv_texture(gpointer data, GstMiniObject *obj)
+{
+    GstBuffer      *buffer = (GstBuffer *)obj;
+    vsink_meta_t   *meta = gst_buffer_get_vsink_meta(buffer);
+
+    TRACE(DEBUG, _b("destroy texture referenced by buffer: %p meta: %p:%p, refcount=%d"), buffer, meta, meta->priv, GST_MINI_OBJECT_REFCOUNT(buffer));
+
+    /* ...destroy texture */
+    texture_destroy(meta->priv);
+}
+
+/* ...input buffer allocation from surround-view camera set */
+static int sview_input_alloc(void *data, GstBuffer *buffer)
+{
+    app_data_t         *app = data;
+    vsink_meta_t       *vmeta = gst_buffer_get_vsink_meta(buffer);
+
+    /* ...allocate texture to wrap the buffer */
+    vmeta->priv = texture_create(vmeta);
+    if (vmeta->priv == NULL)
+    {
+        TRACE(ERROR, _x("unable to create texture"));
+        return -1;
+    }
+
+    /* ...add custom destructor to the buffer */
+    gst_mini_object_weak_ref(GST_MINI_OBJECT(buffer), __destroy_sv_texture, app);
+
+    TRACE(BUFFER, _b("input buffer %p allocated, refcount=%d"), buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+
+    return 0;
+}
+
+/* ...pass buffer to streamer and account it (called with a queue lock held) */
+static void sview_input_stream(app_data_t *app, int i, GstBuffer *buffer)
+{
+    /* ...place buffer into streamer renderer queue (take ownership) */
+    if (app->stream_state != DISABLED)
+    {
+        gst_buffer_ref(buffer);
+        if (stream_pipeline_push_buffer(app, i, app->stream_pipeline, buffer))
+        {
+            /* ...reference has been consumed by streamer anyway */
+            TRACE(ERROR, _b("camera-%d: failed to push buffer in streamer"), i);
+        }
+    }
+
+    /* ...account buffer for benchmark statistics */
+    if (app->flags & APP_FLAG_BENCHMARK)
+    {
+        sview_bench_input(app, i, buffer);
+    }
+}
+
+/* ...place buffer into processing queues (called with a queue lock held) */
+static void sview_input_enqueue(app_data_t *app, int i, GstBuffer *buffer)
+{
+    sview_input_stream(app, i, buffer);
+
+    /* ...account buffer for performance HUD */
+    if (app->flags & APP_FLAG_HUD)
+    {
+        sview_hud_input(app, i, buffer);
+    }
+
+    /* ...place buffer into main rendering queue (take ownership) */
+    g_queue_push_tail(&app->render[i], buffer);
+    gst_buffer_ref(buffer);
+    TRACE(BUFFER, _b("camera-%d enqueue buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+
+    /* ...indicate buffer is available */
+    app->frames &= ~(1 << i);
+
+    /* ...schedule processing if all buffers are ready */
+    if ((app->frames & ((1 << CAMERAS_NUMBER) - 1)) == 0)
+    {
+        /* ...all buffers available; trigger surround-view scene processing */
+        window_schedule_redraw(app->window);
+    }
+}
+
+/* ...pass buffer to renderer through a mailbox (queue lock is not taken normally) */
+static void sview_input_publish(app_data_t *app, int i, GstBuffer *buffer)
+{
+    GstBuffer  *old;
+    int         j;
+
+    /* ...streaming and benchmark statistics are still serialized; the queue lock
+     * is taken on this path while streaming or --benchmark is active */
+    if (app->stream_state != DISABLED || (app->flags & APP_FLAG_BENCHMARK))
+    {
+        pthread_mutex_lock(&app->lock);
+        sview_input_stream(app, i, buffer);
+        pthread_mutex_unlock(&app->lock);
+    }
+
+    /* ...account buffer for performance HUD */
+    if (app->flags & APP_FLAG_HUD)
+    {
+        sview_hud_input(app, i, buffer);
+    }
+
+    /* ...replace pending buffer; renderer always gets the newest one */
+    old = __atomic_exchange_n(&app->mailbox[i], gst_buffer_ref(buffer), __ATOMIC_ACQ_REL);
+    TRACE(BUFFER, _b("camera-%d publish buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+
+    if (old != NULL)
+    {
+        /* ...account buffer that never reached the screen */
+        __atomic_add_fetch(&app->bench[i].skipped, 1, __ATOMIC_RELAXED);
+
+        TRACE(BUFFER, _b("camera-%d dropping buffer %p, refcount=%d"), i, old, GST_MINI_OBJECT_REFCOUNT(old));
+        gst_buffer_unref(old);
+    }
+
+    /* ...renderer may have drained mailboxes between caller's EOS check and the
+     * exchange above; nothing would drain them again, so take the buffer back */
+    if (__atomic_load_n(&app->flags, __ATOMIC_ACQUIRE) & APP_FLAG_EOS)
+    {
+        if ((old = __atomic_exchange_n(&app->mailbox[i], NULL, __ATOMIC_ACQ_REL)) != NULL)
+        {
+            TRACE(BUFFER, _b("camera-%d: dropping buffer: %p, refcount=%d"), i, old, GST_MINI_OBJECT_REFCOUNT(old));
+            gst_buffer_unref(old);
+        }
+
+        return;
+    }
+
+    /* ...schedule processing if all cameras have pending buffers */
+    for (j = 0; j < CAMERAS_NUMBER && __atomic_load_n(&app->mailbox[j], __ATOMIC_ACQUIRE); j++)
+        ;
+
+    if (j == CAMERAS_NUMBER)
+    {
+        window_schedule_redraw(app->window);
+    }
+}
+
+/* ...process input buffer in mailbox mode */
+static int sview_input_mailbox(app_data_t *app, int i, GstBuffer *buffer)
+{
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    vsink_meta_t   *vmeta = gst_buffer_get_vsink_meta(buffer);
+#endif
 
-        TRACE(BUFFER, _b("camera-%d release buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+    /* ...playback is being stopped */
+    if (__atomic_load_n(&app->flags, __ATOMIC_ACQUIRE) & APP_FLAG_EOS)
+    {
+        return 0;
+    }
 
-        /* ...return buffer to a pool */
-        gst_buffer_unref(buffer);
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    if (vmeta && app->upload)
+    {
+        /* ...buffer is published upon upload completion */
+        if (texture_upload_submit(app->upload, i, vmeta->priv, gst_buffer_ref(buffer)) < 0)
+        {
+            TRACE(ERROR, _x("camera-%d: failed to submit texture upload"), i);
+            gst_buffer_unref(buffer);
+        }
 
-        /* ...check if queue gets empty */
-        (g_queue_is_empty(queue) ? app->frames ^= 1 << i : 0);
+        return 0;
     }
 
-    pthread_mutex_unlock(&app->lock);
-}
-
-/*******************************************************************************
- * Interface exposed to the camera backend
- ******************************************************************************/
+    if (vmeta)
+    {
+        texture_update(vmeta->priv);
 
-/* ...deallocate texture data */
-static void __destroy_sv_texture(gpointer data, GstMiniObject *obj)
-{
-    GstBuffer      *buffer = (GstBuffer *)obj;
-    vsink_meta_t   *meta = gst_buffer_get_vsink_meta(buffer);
+        if (app->flags & APP_FLAG_HUD)
+        {
+            sview_hud_upload(app, i, vmeta->priv);
+        }
+    }
+#endif
 
-    TRACE(DEBUG, _b("destroy texture referenced by buffer: %p meta: %p:%p, refcount=%d"), buffer, meta, meta->priv, GST_MINI_OBJECT_REFCOUNT(buffer));
+    sview_input_publish(app, i, buffer);
 
-    /* ...destroy texture */
-    texture_destroy(meta->priv);
+    return 0;
 }
 
-/* ...input buffer allocation from surround-view camera set */
-static int sview_input_alloc(void *data, GstBuffer *buffer)
+/* ...texture upload completion callback (called from upload thread) */
+static void sview_input_uploaded(void *data, int i, void *priv)
 {
-    app_data_t         *app = data;
-    vsink_meta_t       *vmeta = gst_buffer_get_vsink_meta(buffer);
+    app_data_t     *app = data;
+    GstBuffer      *buffer = priv;
 
-    /* ...allocate texture to wrap the buffer */
-    vmeta->priv = texture_create(vmeta);
-    if (vmeta->priv == NULL)
+    /* ...mailbox exchange does not need a queue lock */
+    if (__render_mailbox)
     {
-        TRACE(ERROR, _x("unable to create texture"));
-        return -1;
+        if ((__atomic_load_n(&app->flags, __ATOMIC_ACQUIRE) & APP_FLAG_EOS) == 0)
+        {
+            if (app->flags & APP_FLAG_HUD)
+            {
+                sview_hud_upload(app, i, gst_buffer_get_vsink_meta(buffer)->priv);
+            }
+
+            sview_input_publish(app, i, buffer);
+        }
+
+        gst_buffer_unref(buffer);
+        return;
     }
 
-    /* ...add custom destructor to the buffer */
-    gst_mini_object_weak_ref(GST_MINI_OBJECT(buffer), __destroy_sv_texture, app);
+    pthread_mutex_lock(&app->lock);
 
-    TRACE(BUFFER, _b("input buffer %p allocated, refcount=%d"), buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
+    /* ...pass buffer further unless playback has been stopped meanwhile */
+    if ((app->flags & APP_FLAG_EOS) == 0)
+    {
+        if (app->flags & APP_FLAG_HUD)
+        {
+            sview_hud_upload(app, i, gst_buffer_get_vsink_meta(buffer)->priv);
+        }
 
-    return 0;
+        sview_input_enqueue(app, i, buffer);
+    }
+
+    pthread_mutex_unlock(&app->lock);
+
+    /* ...drop reference held by upload request */
+    gst_buffer_unref(buffer);
 }
 
 /* ...process new input buffer submitted from camera */
@@ -289,6 +1061,12 @@ static int sview_input_process(void *data, int i, GstBuffer *buffer)
 
     TRACE(BUFFER, _b("camera-%d: input buffer %p received, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
 
+    /* ...decoding path does not take a queue lock in mailbox mode */
+    if (__render_mailbox)
+    {
+        return sview_input_mailbox(app, i, buffer);
+    }
+
     /* ...get queue access lock */
     pthread_mutex_lock(&app->lock);
 
@@ -301,36 +1079,32 @@ static int sview_input_process(void *data, int i, GstBuffer *buffer)
         {
             /* External images are updated by HW itself, no need to copy pixels one more time */
 #if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+            if (app->upload)
+            {
+                /* ...pass texture update to upload thread; buffer is queued upon completion */
+                pthread_mutex_unlock(&app->lock);
+
+                if (texture_upload_submit(app->upload, i, vmeta->priv, gst_buffer_ref(buffer)) < 0)
+                {
+                    TRACE(ERROR, _x("camera-%d: failed to submit texture upload"), i);
+                    gst_buffer_unref(buffer);
+                }
+
+                return 0;
+            }
+
             /* ...update texture data with the new buffer content */
             texture_update(vmeta->priv);
-#endif
-        }
 
-        /* ...place buffer into streamer renderer queue (take ownership) */
-        if (app->stream_state != DISABLED)
-        {
-            gst_buffer_ref(buffer);
-            if (stream_pipeline_push_buffer(app, i, app->stream_pipeline, buffer))
+            if (app->flags & APP_FLAG_HUD)
             {
-                gst_buffer_unref(buffer);
-                TRACE(ERROR, _b("camera-%d: failed to push buffer in streamer"), i);
+                sview_hud_upload(app, i, vmeta->priv);
             }
+#endif
         }
 
-        /* ...place buffer into main rendering queue (take ownership) */
-        g_queue_push_tail(&app->render[i], buffer);
-        gst_buffer_ref(buffer);
-        TRACE(BUFFER, _b("camera-%d enqueue buffer %p, refcount=%d"), i, buffer, GST_MINI_OBJECT_REFCOUNT(buffer));
-
-        /* ...indicate buffer is available */
-        app->frames &= ~(1 << i);
-
-        /* ...schedule processing if all buffers are ready */
-        if ((app->frames & ((1 << CAMERAS_NUMBER) - 1)) == 0)
-        {
-            /* ...all buffers available; trigger surround-view scene processing */
-            window_schedule_redraw(app->window);
-        }
+        /* ...pass buffer to streamer and renderer */
+        sview_input_enqueue(app, i, buffer);
     }
 
     /* ...release queue access lock */
@@ -349,41 +1123,133 @@ static const camera_callback_t sv_camera_cb = {
  * Rendering functions
  ******************************************************************************/
 
-/* ...draw multiline string - hmm; need to put that stuff into display */
-static inline void draw_string(cairo_t *cr, const char *fmt, ...)
+/* ...on-screen text color */
+static const float __overlay_color[4] = { 1.0f, 1.0f, 1.0f, 0.5f };
+
+/* ...on-screen text font size (pixels) */
+#define SV_OVERLAY_FONT_SIZE            40
+
+/* ...frame set rendering decision */
+#define SVIEW_DRAW_NONE                 0
+#define SVIEW_DRAW_SCENE                1
+#define SVIEW_DRAW_OVERLAY              2
+
+/* ...drop frame set that is not going to be rendered */
+static void sview_drop_buffers(app_data_t *app, GstBuffer **buffers, GstMapInfo *maps)
 {
-    char                    buffer[4096], *p, *end;
-    cairo_text_extents_t    text_extents;
-    cairo_font_extents_t    font_extents;
-    va_list                 argp;
-
-    cairo_save(cr);
-    cairo_select_font_face(cr, "sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 40);
-    cairo_font_extents(cr, &font_extents);
-
-    va_start(argp, fmt);
-    vsnprintf(buffer, sizeof(buffer), fmt, argp);
-    va_end(argp);
-
-    for (p = buffer; *p; p = end + 1)
-    {
-        /* ...output single line */
-        ((end = strchr(p, '\n')) != NULL ? *end = 0 : 0);
-        cairo_show_text(cr, p);
-        cairo_text_extents (cr, p, &text_extents);
-        cairo_rel_move_to (cr, -text_extents.x_advance, font_extents.height);
-        TRACE(0, _b("print text-line: <%f,%f>"), text_extents.x_advance, font_extents.height);
-
-        /* ...stop when last line processes */
-        if (!end)
+    int         i;
+
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        if (maps[i].memory)
         {
-            break;
+            gst_buffer_unmap(buffers[i], &maps[i]);
+            memset(&maps[i], 0, sizeof(maps[i]));
+        }
+    }
+
+    sview_release_buffers(app, buffers);
+}
+
+/* ...decide how to render a frame set when paused or hidden */
+static int sview_idle_select(app_data_t *app,
+                             GstBuffer **buffers,
+                             texture_data_t **texture,
+                             GLuint *tex,
+                             void **planes,
+                             GstMapInfo *maps)
+{
+    u32         ts = get_time_usec();
+    int         due = (u32)(ts - app->idle_ts) >= 1000000U / __idle_fps;
+    int         i;
+
+    if ((app->flags & APP_FLAG_PAUSE) == 0)
+    {
+        /* ...playback resumed; return frozen set */
+        sview_idle_release(app);
+
+        /* ...window is not presented by compositor; throttle rendering */
+        if (!window_is_visible(app->window) && !due)
+        {
+            sview_drop_buffers(app, buffers, maps);
+            return SVIEW_DRAW_NONE;
         }
+
+        app->idle_ts = ts;
+        return SVIEW_DRAW_SCENE;
+    }
+
+    /* ...freeze first set after pausing; detach it from the queues keeping references */
+    if (app->held[0] == NULL)
+    {
+        for (i = 0; i < CAMERAS_NUMBER; i++)
+        {
+            app->held[i] = gst_buffer_ref(buffers[i]);
+            app->held_tex[i] = texture[i];
+        }
+
+        memcpy(app->held_maps, maps, sizeof(app->held_maps));
+        memset(maps, 0, sizeof(app->held_maps));
+        sview_release_buffers(app, buffers);
+
+        memcpy(buffers, app->held, sizeof(app->held));
+        app->idle_ts = ts, app->scene_dirty = 0;
+        return SVIEW_DRAW_SCENE;
+    }
+
+    /* ...new frames are not displayed while paused */
+    sview_drop_buffers(app, buffers, maps);
+
+    /* ...frozen scene without on-screen text needs no update at all */
+    if (!due || (!app->scene_dirty && app->damage[2] == 0 && !(app->flags & (APP_FLAG_HUD | APP_FLAG_DEBUG))))
+    {
+        return SVIEW_DRAW_NONE;
+    }
+
+    /* ...substitute frozen set */
+    for (i = 0; i < CAMERAS_NUMBER; i++)
+    {
+        buffers[i] = app->held[i];
+        texture[i] = app->held_tex[i];
+        tex[i] = texture[i]->tex;
+        planes[i] = texture[i]->data[0];
+    }
+
+    app->idle_ts = ts;
+
+    /* ...only overlay changes unless view has been modified */
+    if (app->scene_dirty)
+    {
+        app->scene_dirty = 0;
+        return SVIEW_DRAW_SCENE;
+    }
+
+    return SVIEW_DRAW_OVERLAY;
+}
+
+/* ...collect window damage (previous and current overlay area) */
+static int sview_overlay_damage(app_data_t *app, int draw, int drawn, int *rects)
+{
+    int         n = 0;
+
+    /* ...previous text has to be erased */
+    if (app->damage[2] > 0 && app->damage[3] > 0)
+    {
+        memcpy(&rects[4 * n++], app->damage, sizeof(app->damage));
+    }
+
+    /* ...remember area covered by current text */
+    if (drawn && overlay_bounds(app->overlay, app->damage))
+    {
+        memcpy(&rects[4 * n++], app->damage, sizeof(app->damage));
+    }
+    else
+    {
+        memset(app->damage, 0, sizeof(app->damage));
     }
 
-    /* ...restore drawing context */
-    cairo_restore(cr);
+    /* ...whole window is damaged if scene has been rendered */
+    return (draw == SVIEW_DRAW_OVERLAY ? n : 0);
 }
 
 /* ...surround-view scene rendering */
@@ -397,7 +1263,6 @@ static void sview_redraw(display_data_t *display, void *data)
     GLuint              tex[CAMERAS_NUMBER];
     void               *planes[CAMERAS_NUMBER];
     s64                 ts;
-    char                need_tex_destroy = 0;
     VehicleState       vehicle_info;
 
 
@@ -411,70 +1276,113 @@ static void sview_redraw(display_data_t *display, void *data)
                             tex,
                             planes,
                             &ts,
-                            &need_tex_destroy,
                             buffer_maps))
     {
-        float       fps = window_frame_rate_update(window);
-        cairo_t    *cr;
+        int         draw = sview_idle_select(app, buffers, texture, tex, planes, buffer_maps);
+        int         hud = app->flags & APP_FLAG_HUD;
+        gpu_timer_t *timer = (hud ? app->gpu_timer : NULL);
+        int         rects[8], drawn = 0;
+        float       fps;
+        u32         t0, t1, t2;
         int         camera;
 
+        /* ...frame set is not rendered */
+        if (draw == SVIEW_DRAW_NONE)
+        {
+            continue;
+        }
+
+        /* ...make sure asynchronous texture uploads are complete */
+        for (camera = 0; camera < CAMERAS_NUMBER; camera++)
+        {
+            if (texture_wait(texture[camera]) > 0)
+            {
+                break;
+            }
+        }
+
+        /* ...upload is late; keep previously presented frame on screen */
+        if (camera < CAMERAS_NUMBER)
+        {
+            TRACE(DEBUG, _b("camera-%d texture is not ready; frame set skipped"), camera);
+            (buffers[0] != app->held[0] ? sview_drop_buffers(app, buffers, buffer_maps) : (void)0);
+            continue;
+        }
+
+        fps = window_frame_rate_update(window);
+        t0 = get_time_usec();
+
         sview_engine_set_frame_rate(app->sv, fps);
 
         window_clear(window);
 
-        /* ...draw graphics on top of the scene */
-        cr = window_get_cairo(window);
-
         /* ...generate a single scene; acquire engine access lock */
         pthread_mutex_lock(&app->access);
 
+        t1 = get_time_usec();
+        (timer ? gpu_timer_begin(timer) : (void)0);
+
         sview_engine_process(app->sv, tex, (const uint8_t **)planes, &vehicle_info);
 
-        pthread_mutex_unlock(&app->access);
+        (timer ? gpu_timer_end(timer) : (void)0);
+        t1 = get_time_usec() - t1;
 
-        // Cairo output is clipped if this flag is set
-        // make sure it is disabled before performing Cairo draw
-        glDisable(GL_CULL_FACE);
+        pthread_mutex_unlock(&app->access);
 
-        /* ...output frame-rate in the upper-left corner */
-        if (app->flags & APP_FLAG_DEBUG)
+        /* ...output performance HUD or frame-rate in the upper-left corner */
+        if (hud && app->overlay)
+        {
+            overlay_draw(app->overlay, window, 40, 40, __overlay_color, "%s", app->hud_text);
+            drawn = 1;
+        }
+        else if ((app->flags & APP_FLAG_DEBUG) && app->overlay)
         {
-            /* FIXME: This is a workaround to fix Cairo's scrambled context
-             *        that causes rendering of rectangles instead of text:
-             *        Flush surface by drawing transparent rectangle */
-            cairo_rectangle(cr, 0, 0, 1, 1);
-            cairo_set_source_rgba(cr, 0, 0, 0, 1);
-            cairo_fill(cr);
-            /* FIXME: End of workaround */
-
-            glViewport(0, 0, window_get_width(window), window_get_height(window));
-
-            cairo_set_source_rgba(cr, 1, 1, 1, 0.5);
-            cairo_move_to(cr, 40, 80);
-            draw_string(cr, "%.1f FPS", fps);
+            overlay_draw(app->overlay, window, 40, 40, __overlay_color, "%.1f FPS", fps);
+            drawn = 1;
         }
         else
         {
             TRACE(DEBUG, _b("main-window fps: %.1f"), fps);
         }
 
-        /* ...release cairo interface */
-        window_put_cairo(window, cr);
-
         /* ...submit window to a compositor */
-        window_draw(window);
+        t2 = get_time_usec();
+        window_draw_damage(window, rects, sview_overlay_damage(app, draw, drawn, rects));
+        t2 = get_time_usec() - t2;
 
-        if (need_tex_destroy)
+        /* ...update performance HUD; restart collection once it gets re-enabled */
+        if (hud)
         {
-            int i;
+            sview_hud_update(app, fps, t1, t2);
+        }
+        else
+        {
+            app->hud_ts = 0;
+        }
 
-            /* ...destroy textures if they were created for this set of buffers only */
-            for (i = 0; i < CAMERAS_NUMBER; i++)
+        /* ...update benchmark statistics */
+        if (app->flags & APP_FLAG_BENCHMARK)
+        {
+            sview_bench_render(app, buffers, get_time_usec() - t0);
+        }
+
+        /* ...frozen frame set is kept until playback is resumed */
+        if (buffers[0] == app->held[0])
+        {
+            continue;
+        }
+
+        /* ...unmap buffers uploaded into cached textures (textures are kept) */
+        for (camera = 0; camera < CAMERAS_NUMBER; camera++)
+        {
+            if (buffer_maps[camera].memory == NULL)
             {
-                texture_destroy(texture[i]);
-                TRACE(BUFFER, _b("camera-%d unmap buffer: %p, refcount=%d"), i, buffers[i], GST_MINI_OBJECT_REFCOUNT(buffers[i]));
-                gst_buffer_unmap(buffers[i], &buffer_maps[i]);
+                continue;
             }
+
+            TRACE(BUFFER, _b("camera-%d unmap buffer: %p, refcount=%d"), camera, buffers[camera], GST_MINI_OBJECT_REFCOUNT(buffers[camera]));
+            gst_buffer_unmap(buffers[camera], &buffer_maps[camera]);
+            memset(&buffer_maps[camera], 0, sizeof(buffer_maps[camera]));
         }
 
         /* ...release buffers collected */
@@ -484,13 +1392,28 @@ static void sview_redraw(display_data_t *display, void *data)
     TRACE(DEBUG, _b("surround-view drawing complete"));
 }
 
+/* ...engine configuration (textures are RGB if converted by a shader) */
+static sview_cfg_t * sview_engine_cfg(app_data_t *app)
+{
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    if (__display_yuv_convert)
+    {
+        app->engine_cfg = *app->sv_cfg;
+        app->engine_cfg.pixformat = GST_VIDEO_FORMAT_RGBA;
+        return &app->engine_cfg;
+    }
+#endif
+
+    return app->sv_cfg;
+}
+
 static void sview_init_bv(display_data_t *display, void *data)
 {
     app_data_t         *app = data;
     /* ...generate a single scene; acquire engine access lock */
     pthread_mutex_lock(&app->access);
     app->sv = sview_bv_reinit(app->sv,
-                              app->sv_cfg,
+                              sview_engine_cfg(app),
                               app->sv_cfg->cam_width,
                               app->sv_cfg->cam_height);
     pthread_mutex_unlock(&app->access);
@@ -587,18 +1510,45 @@ static int app_context_init(widget_data_t *widget, void *data)
     int             H = widget_get_height(widget);
 
     /* ...initialize surround-view engine */
-    CHK_ERR(app->sv = sview_engine_init(app->sv_cfg,
+    CHK_ERR(app->sv = sview_engine_init(sview_engine_cfg(app),
                                         app->sv_cfg->cam_width,
                                         app->sv_cfg->cam_height), -errno);
 
     app_main_info.width  = W;
     app_main_info.height = H;
 
+    /* ...create text overlay (not fatal if unavailable) */
+    if ((app->overlay = overlay_create(SV_OVERLAY_FONT_SIZE)) == NULL)
+    {
+        TRACE(WARNING, _x("failed to create text overlay: %m"));
+    }
+
+    /* ...GPU timer for performance HUD (optional) */
+    app->gpu_timer = gpu_timer_create();
+
     TRACE(INIT, _b("run-time initialized: %u*%u"), W, H);
 
     return 0;
 }
 
+/* ...destroy GL-processing context data (window context is current) */
+static void app_context_destroy(widget_data_t *widget, void *data)
+{
+    app_data_t     *app = data;
+
+    if (app->overlay)
+    {
+        overlay_destroy(app->overlay);
+        app->overlay = NULL;
+    }
+
+    if (app->gpu_timer)
+    {
+        gpu_timer_destroy(app->gpu_timer);
+        app->gpu_timer = NULL;
+    }
+}
+
 /*******************************************************************************
  * Input events processing
  ******************************************************************************/
@@ -659,6 +1609,28 @@ static inline widget_data_t * app_touch_event(app_data_t *app,
 static inline widget_data_t * app_key_event(app_data_t *app,
         widget_data_t *widget, widget_key_event_t *event)
 {
+    /* ...performance HUD toggling is not passed to the engine */
+    if (event->type == WIDGET_EVENT_KEY_PRESS && event->code == KEY_F12)
+    {
+        if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED)
+        {
+            app_hud_enable(app, !(app->flags & APP_FLAG_HUD));
+        }
+
+        return widget;
+    }
+
+    /* ...playback freezing as well */
+    if (event->type == WIDGET_EVENT_KEY_PRESS && event->code == KEY_PAUSE)
+    {
+        if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED)
+        {
+            app_pause(app, !(app->flags & APP_FLAG_PAUSE));
+        }
+
+        return widget;
+    }
+
     pthread_mutex_lock(&app->access);
 
     if (app->flags & APP_FLAG_SVIEW)
@@ -717,6 +1689,9 @@ static widget_data_t * app_input_event(widget_data_t *widget, void *cdata, widge
     app_data_t     *app = cdata;
     widget_data_t  *focus;
 
+    /* ...view may change; frozen scene has to be re-rendered */
+    app->scene_dirty = 1;
+
     /* ...pass event to GUI layer first */
     if (!app->gui || !(focus = widget_input_event(app->gui, event)) || focus == widget)
     {
@@ -828,6 +1803,7 @@ static widget_info_t app_main_info2 =
 {
     .init = app_context_init,
     .event = app_input_event,
+    .destroy = app_context_destroy,
 };
 
 /* ...start surround-view track */
@@ -867,6 +1843,7 @@ void * app_thread(void *arg)
 {
     app_data_t     *app = arg;
     track_desc_t   *track = NULL;
+    GstElement     *pipe;
 
     /* ...acquire internal data access lock */
     pthread_mutex_lock(&app->lock);
@@ -921,11 +1898,12 @@ void * app_thread(void *arg)
 
         TRACE(INFO, _b("track '%s' completed"), (track->info ? : "default"));
 
-        stream_pipeline_destroy(app);
-
         /* ...release internal lock to allow termination sequence to complete */
         pthread_mutex_unlock(&app->lock);
 
+        /* ...streaming pipeline is torn down without blocking decoders */
+        stream_pipeline_destroy(app);
+
         /* ...stop the pipeline (stop streaming) */
         gst_element_set_state(app->pipe, GST_STATE_NULL);
 
@@ -950,21 +1928,33 @@ void * app_thread(void *arg)
         app->flags &= ~APP_FLAG_EOS;
     }
 
+    /* ...detach pipeline from late end-of-stream requests */
+    pipe = app->pipe, app->pipe = NULL;
+
     /* ...release internal data access lock */
     pthread_mutex_unlock(&app->lock);
 
     /* ...destroy pipeline and all hosted elements */
-    gst_object_unref(app->pipe);
+    gst_object_unref(pipe);
 
     return NULL;
 }
 
-/* ...end-of-stream signalization */
+/* ...end-of-stream signalization (any thread) */
 void app_eos(app_data_t *app)
 {
-    GstMessage     *message = gst_message_new_eos(GST_OBJECT(app->pipe));
+    GstElement     *pipe;
+
+    /* ...pipeline pointer is sampled under lock; keep it alive while posting */
+    pthread_mutex_lock(&app->lock);
+    pipe = (app->pipe ? gst_object_ref(app->pipe) : NULL);
+    pthread_mutex_unlock(&app->lock);
 
-    gst_element_post_message(GST_ELEMENT_CAST(app->pipe), message);
+    if (pipe)
+    {
+        gst_element_post_message(pipe, gst_message_new_eos(GST_OBJECT(pipe)));
+        gst_object_unref(pipe);
+    }
 }
 
 /* ...network packet reception hook */
@@ -1105,6 +2095,44 @@ void app_debug_enable(app_data_t *app, int enable)
     TRACE(INFO, _b("debug-data output enable: %d"), enable);
 }
 
+/* ...enable performance HUD */
+void app_hud_enable(app_data_t *app, int enable)
+{
+    pthread_mutex_lock(&app->lock);
+
+    if (enable)
+    {
+        app->flags |= APP_FLAG_HUD;
+    }
+    else
+    {
+        app->flags &= ~APP_FLAG_HUD;
+    }
+
+    pthread_mutex_unlock(&app->lock);
+
+    TRACE(INFO, _b("performance HUD enable: %d"), enable);
+}
+
+/* ...freeze displayed frames and render at reduced rate */
+void app_pause(app_data_t *app, int enable)
+{
+    pthread_mutex_lock(&app->lock);
+
+    if (enable)
+    {
+        app->flags |= APP_FLAG_PAUSE;
+    }
+    else
+    {
+        app->flags &= ~APP_FLAG_PAUSE;
+    }
+
+    pthread_mutex_unlock(&app->lock);
+
+    TRACE(INFO, _b("playback pause: %d"), enable);
+}
+
 /* ...close application */
 void app_exit(app_data_t *app)
 {
@@ -1133,12 +2161,22 @@ static void app_destroy(gpointer data, GObject *obj)
     /* ...destroy main loop */
     g_main_loop_unref(app->loop);
 
+    /* ...complete pending uploads and stop upload thread */
+    (app->upload ? texture_upload_destroy(app->upload) : 0);
+
     /* ...destroy GUI layer */
     (app->gui ? widget_destroy(app->gui) : 0);
 
     /* ...destroy surround-view engine data */
     (app->sv ? sview_engine_destroy(app->sv) : 0);
 
+    /* ...destroy cached textures */
+    sview_texture_cache_flush(app);
+
+    /* ...drop buffers not picked by renderer */
+    sview_mailbox_drain(app);
+    sview_idle_release(app);
+
     /* ...destroy main application window */
     (app->window ? window_destroy(app->window) : 0);
 
@@ -1249,9 +2287,20 @@ app_data_t * app_init(display_data_t *display, sview_cfg_t *sv_cfg, int flags)
     /* ...initialize engine access lock */
     pthread_mutex_init(&app->access, NULL);
 
+    /* ...initialize streaming pipeline lifecycle lock */
+    pthread_mutex_init(&app->stream_lock, NULL);
+
     /* ...initialize synchronous operation completion variable */
     pthread_cond_init(&app->wait, NULL);
 
+#if !defined (EGL_HAS_IMG_EXTERNAL_EXT)
+    /* ...create texture upload thread if requested */
+    if (__async_upload && (app->upload = texture_upload_create(sview_input_uploaded, app)) == NULL)
+    {
+        TRACE(WARNING, _x("failed to create upload thread; using synchronous upload: %m"));
+    }
+#endif
+
     TRACE(INIT, _b("module initialized"));
 
     return app;
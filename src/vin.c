@@ -29,7 +29,10 @@
  * Includes
  ******************************************************************************/
 
+#define _GNU_SOURCE
+
 #include <fcntl.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/poll.h>
@@ -53,9 +56,12 @@ TRACE_TAG(BUFFER, 1);
  * Local constants definitions
  ******************************************************************************/
 
-/* ...individual camera buffer pool size */
+/* ...default individual camera buffer pool size */
 #define VIN_BUFFER_POOL_SIZE            8
 
+/* ...maximal number of memory planes per buffer */
+#define VIN_MAX_PLANES                  2
+
 /*******************************************************************************
  * Local types definitions
  ******************************************************************************/
@@ -63,14 +69,17 @@ TRACE_TAG(BUFFER, 1);
 /* ...buffer description */
 typedef struct vin_buffer
 {
-    /* ...data pointer */
-    void               *data;
+    /* ...data pointers (per memory plane) */
+    void               *data[VIN_MAX_PLANES];
 
-    /* ...memory offset */
-    u32                 offset;
+    /* ...memory offsets */
+    u32                 offset[VIN_MAX_PLANES];
 
-    /* ...buffer length */
-    u32                 length;
+    /* ...planes lengths */
+    u32                 length[VIN_MAX_PLANES];
+
+    /* ...exported DMA file-descriptors (-1 if not exported) */
+    int                 dmafd[VIN_MAX_PLANES];
 
     /* ...associated GStreamer buffer */
     GstBuffer          *buffer;
@@ -80,15 +89,51 @@ typedef struct vin_buffer
 /* ...particular VIN device data */
 typedef struct vin_device
 {
+    /* ...owning decoder */
+    struct vin_decoder *dec;
+
+    /* ...device index within a decoder */
+    int                 id;
+
     /* ...file descriptor */
     int                 vfd;
 
+    /* ...buffer type (single- or multi-planar capture) */
+    u32                 type;
+
+    /* ...number of memory planes per buffer */
+    int                 n_planes;
+
+    /* ...line lengths of memory planes reported by driver (bytes) */
+    u32                 stride[VIN_MAX_PLANES];
+
+    /* ...number of buffers queued to the device */
+    int                 queued;
+
+    /* ...dedicated capture thread (per-device threads mode) */
+    pthread_t           thread;
+
     /* ...buffer pool */
-    vin_buffer_t        pool[VIN_BUFFER_POOL_SIZE];
+    vin_buffer_t       *pool;
+
+    /* ...number of buffers in a pool */
+    int                 pool_size;
 
     /* ...input buffer waiting conditional */
     pthread_cond_t      wait;
 
+    /* ...device queue access lock (QBUF/DQBUF and sequence tracking) */
+    pthread_mutex_t     lock;
+
+    /* ...sequence number of last dequeued frame */
+    u32                 sequence;
+
+    /* ...number of frames dropped by the driver */
+    u32                 dropped;
+
+    /* ...first frame indicator (sequence not yet valid) */
+    int                 started;
+
 }   vin_device_t;
 
 /* ...decoder data structure */
@@ -112,7 +157,13 @@ typedef struct vin_decoder
     /* ...decoder activity state */
     int                         active;
 
-    /* ...queue access lock */
+    /* ...per-device capture threads mode */
+    int                         threaded;
+
+    /* ...shutdown notification descriptor (-1 if not used) */
+    int                         efd;
+
+    /* ...shared state access lock (counters and activity flag) */
     pthread_mutex_t             lock;
 
     /* ...decoding thread - tbd - make it a data source for GMainLoop? */
@@ -240,7 +291,7 @@ const GstMetaInfo * vin_meta_get_info(void)
  * V4L2 VIN interface helpers
  ******************************************************************************/
 
-/* ...check video device capabilities */
+/* ...check video device capabilities (returns buffer type to use) */
 static inline int __vin_check_caps(int vfd)
 {
     struct v4l2_capability  cap;
@@ -248,148 +299,334 @@ static inline int __vin_check_caps(int vfd)
 
     /* ...query device capabilities */
     CHK_API(ioctl(vfd, VIDIOC_QUERYCAP, &cap));
-    caps = cap.device_caps;
+    caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS ? cap.device_caps : cap.capabilities);
 
     /* ...check for a required capabilities */
-    if (!(caps & V4L2_CAP_VIDEO_CAPTURE))
+    if (!(caps & V4L2_CAP_STREAMING))
     {
-        TRACE(ERROR, _x("single-planar output expected: %X"), caps);
-        return -1;
+        TRACE(ERROR, _x("streaming I/O is expected: %X"), caps);
+        return -(errno = EINVAL);
     }
-    else if (!(caps & V4L2_CAP_STREAMING))
+    else if (caps & V4L2_CAP_VIDEO_CAPTURE)
     {
-        TRACE(ERROR, _x("streaming I/O is expected: %X"), caps);
-        return -1;
+        return V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    }
+    else if (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+    {
+        return V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    }
+    else
+    {
+        TRACE(ERROR, _x("video capture device expected: %X"), caps);
+        return -(errno = EINVAL);
     }
+}
 
-    /* ...all good */
-    return 0;
+/* ...check if pixel format is supported by the device */
+static inline int __vin_check_format(vin_device_t *dev, u32 format)
+{
+    struct v4l2_fmtdesc     desc;
+
+    /* ...enumerate formats supported by the device */
+    memset(&desc, 0, sizeof(desc));
+    desc.type = dev->type;
+    for (desc.index = 0; ioctl(dev->vfd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+    {
+        TRACE(DEBUG, _b("format #%u: '%.4s' (%s)"),
+              desc.index, (char *)&desc.pixelformat, desc.description);
+
+        if (desc.pixelformat == format)
+        {
+            return 0;
+        }
+    }
+
+    TRACE(ERROR, _x("pixel format '%.4s' is not supported by device"), (char *)&format);
+
+    return -(errno = EINVAL);
 }
 
 /* ...prepare VIN module for operation */
-static inline int vin_set_formats(int vfd, int width, int height, u32 format)
+static inline int vin_set_formats(vin_device_t *dev, int width, int height, u32 format)
 {
     struct v4l2_format  fmt;
 
-    /* ...set output format (single-plane NV12/NV16/UYVY? - tbd) */
+    /* ...make sure format is supported */
+    CHK_API(__vin_check_format(dev, format));
+
+    /* ...set output format (single memory plane is requested for all formats) */
     memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.pixelformat = format;
-    fmt.fmt.pix.field = V4L2_FIELD_ANY;
-    fmt.fmt.pix.width = width;
-    fmt.fmt.pix.height = height;
-    CHK_API(ioctl(vfd, VIDIOC_S_FMT, &fmt));
+    fmt.type = dev->type;
+    if (dev->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+    {
+        fmt.fmt.pix_mp.pixelformat = format;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+        fmt.fmt.pix_mp.width = width;
+        fmt.fmt.pix_mp.height = height;
+        fmt.fmt.pix_mp.num_planes = 1;
+        CHK_API(ioctl(dev->vfd, VIDIOC_S_FMT, &fmt));
+        CHK_ERR(fmt.fmt.pix_mp.pixelformat == format, -(errno = EINVAL));
+        CHK_ERR(fmt.fmt.pix_mp.width == (u32)width && fmt.fmt.pix_mp.height == (u32)height, -(errno = EINVAL));
+        CHK_ERR((dev->n_planes = fmt.fmt.pix_mp.num_planes) <= VIN_MAX_PLANES, -(errno = EINVAL));
+        dev->stride[0] = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+        dev->stride[1] = (dev->n_planes > 1 ? fmt.fmt.pix_mp.plane_fmt[1].bytesperline : dev->stride[0]);
+    }
+    else
+    {
+        fmt.fmt.pix.pixelformat = format;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+        fmt.fmt.pix.width = width;
+        fmt.fmt.pix.height = height;
+        CHK_API(ioctl(dev->vfd, VIDIOC_S_FMT, &fmt));
+        CHK_ERR(fmt.fmt.pix.pixelformat == format, -(errno = EINVAL));
+        CHK_ERR(fmt.fmt.pix.width == (u32)width && fmt.fmt.pix.height == (u32)height, -(errno = EINVAL));
+        dev->n_planes = 1;
+
+        /* ...semi-planar chroma shares luma line length */
+        dev->stride[0] = dev->stride[1] = fmt.fmt.pix.bytesperline;
+    }
+
+    TRACE(INIT, _b("format set: %d*%d '%.4s' (%s, %d plane(s), stride=%u/%u)"),
+          width, height, (char *)&format,
+          (dev->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ? "mplane" : "single-plane"),
+          dev->n_planes, dev->stride[0], dev->stride[1]);
+
+    return 0;
+}
+
+/* ...set capturing frame rate */
+static inline int vin_set_frame_rate(vin_device_t *dev, int fps)
+{
+    struct v4l2_streamparm  parm;
+    struct v4l2_fract      *tpf = &parm.parm.capture.timeperframe;
+
+    /* ...check if device allows frame interval control */
+    memset(&parm, 0, sizeof(parm));
+    parm.type = dev->type;
+    CHK_API(ioctl(dev->vfd, VIDIOC_G_PARM, &parm));
+
+    if (!(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME))
+    {
+        TRACE(WARNING, _b("frame rate control is not supported; ignore %d fps"), fps);
+        return 0;
+    }
+
+    /* ...set desired frame interval */
+    tpf->numerator = 1, tpf->denominator = fps;
+    CHK_API(ioctl(dev->vfd, VIDIOC_S_PARM, &parm));
+
+    TRACE(INIT, _b("frame interval set: %u/%u"), tpf->numerator, tpf->denominator);
 
     return 0;
 }
 
 /* ...start/stop streaming on specific V4L2 device */
-static inline int vin_streaming_enable(int vfd, int enable)
+static inline int vin_streaming_enable(vin_device_t *dev, int enable)
+{
+    int     type = dev->type;
+
+    return CHK_API(ioctl(dev->vfd, (enable ? VIDIOC_STREAMON : VIDIOC_STREAMOFF), &type));
+}
+
+/* ...prepare buffer descriptor for a query */
+static inline void __vin_buffer_init(vin_device_t *dev, struct v4l2_buffer *buf, struct v4l2_plane *planes)
+{
+    memset(buf, 0, sizeof(*buf));
+    buf->type = dev->type;
+    buf->memory = V4L2_MEMORY_MMAP;
+
+    if (dev->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+    {
+        memset(planes, 0, sizeof(*planes) * VIN_MAX_PLANES);
+        buf->m.planes = planes;
+        buf->length = VIN_MAX_PLANES;
+    }
+}
+
+/* ...export buffer plane as DMA file-descriptor (-1 if not supported) */
+static inline int vin_export_buffer(vin_device_t *dev, int j, int k)
 {
-    int     type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    struct v4l2_exportbuffer    expbuf;
+
+    memset(&expbuf, 0, sizeof(expbuf));
+    expbuf.type = dev->type;
+    expbuf.index = j;
+    expbuf.plane = k;
+    expbuf.flags = O_CLOEXEC | O_RDWR;
+
+    if (ioctl(dev->vfd, VIDIOC_EXPBUF, &expbuf) < 0)
+    {
+        TRACE(DEBUG, _b("output-buffer-%d:%d export failed: %m"), j, k);
+        return -1;
+    }
 
-    return CHK_API(ioctl(vfd, (enable ? VIDIOC_STREAMON : VIDIOC_STREAMOFF), &type));
+    return expbuf.fd;
 }
 
 /* ...allocate buffer pool */
-static inline int vin_allocate_buffers(int vfd, vin_buffer_t *pool, int num)
+static inline int vin_allocate_buffers(vin_device_t *dev, int num)
 {
     struct v4l2_requestbuffers  reqbuf;
     struct v4l2_buffer          buf;
-    int                         j;
+    struct v4l2_plane           planes[VIN_MAX_PLANES];
+    int                         j, k;
 
     /* ...all buffers are allocated by kernel */
     memset(&reqbuf, 0, sizeof(reqbuf));
-    reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    reqbuf.type = dev->type;
     reqbuf.memory = V4L2_MEMORY_MMAP;
     reqbuf.count = num;
-    CHK_API(ioctl(vfd, VIDIOC_REQBUFS, &reqbuf));
-    CHK_ERR(reqbuf.count == (u32)num, -(errno = ENOMEM));
+    CHK_API(ioctl(dev->vfd, VIDIOC_REQBUFS, &reqbuf));
+
+    /* ...driver may adjust the number of buffers; accept anything that can stream */
+    CHK_ERR(reqbuf.count >= 2, -(errno = ENOMEM));
+    if (reqbuf.count != (u32)num)
+    {
+        TRACE(WARNING, _b("requested %d buffers, driver allocated %u"), num, reqbuf.count);
+    }
+
+    /* ...allocate pool descriptors */
+    CHK_ERR(dev->pool = calloc(dev->pool_size = reqbuf.count, sizeof(*dev->pool)), -(errno = ENOMEM));
+
+    /* ...nothing is exported yet */
+    for (j = 0; j < dev->pool_size; j++)
+    {
+        for (k = 0; k < VIN_MAX_PLANES; k++)
+        {
+            dev->pool[j].dmafd[k] = -1;
+        }
+    }
 
-    /* ...prepare query data */
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    for (j = 0; j < num; j++)
+    /* ...map buffers into user-space */
+    for (j = 0; j < dev->pool_size; j++)
     {
-        vin_buffer_t   *_buf = &pool[j];
+        vin_buffer_t   *_buf = &dev->pool[j];
 
         /* ...query buffer */
+        __vin_buffer_init(dev, &buf, planes);
         buf.index = j;
-        CHK_API(ioctl(vfd, VIDIOC_QUERYBUF, &buf));
-        _buf->length = buf.length;
-        _buf->offset = buf.m.offset;
-        _buf->data = mmap(NULL, _buf->length, PROT_READ | PROT_WRITE, MAP_SHARED, vfd, _buf->offset);
-        CHK_ERR(_buf->data != MAP_FAILED, -errno);
+        CHK_API(ioctl(dev->vfd, VIDIOC_QUERYBUF, &buf));
 
-        TRACE(DEBUG, _b("output-buffer-%d mapped: %p[%08X] (%u bytes)"),
-                j, _buf->data, _buf->offset, _buf->length);
+        for (k = 0; k < dev->n_planes; k++)
+        {
+            if (dev->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+            {
+                _buf->length[k] = planes[k].length;
+                _buf->offset[k] = planes[k].m.mem_offset;
+            }
+            else
+            {
+                _buf->length[k] = buf.length;
+                _buf->offset[k] = buf.m.offset;
+            }
+
+            _buf->data[k] = mmap(NULL, _buf->length[k], PROT_READ | PROT_WRITE, MAP_SHARED, dev->vfd, _buf->offset[k]);
+            CHK_ERR(_buf->data[k] != MAP_FAILED, -errno);
+
+            TRACE(DEBUG, _b("output-buffer-%d:%d mapped: %p[%08X] (%u bytes)"),
+                    j, k, _buf->data[k], _buf->offset[k], _buf->length[k]);
+
+            /* ...export plane for zero-copy import by other devices */
+            _buf->dmafd[k] = vin_export_buffer(dev, j, k);
+        }
     }
 
     /* ...start streaming as soon as we allocated buffers */
-    CHK_API(vin_streaming_enable(vfd, 1));
+    CHK_API(vin_streaming_enable(dev, 1));
 
-    TRACE(BUFFER, _b("buffer-pool allocated (%u buffers)"), num);
+    TRACE(BUFFER, _b("buffer-pool allocated (%u buffers)"), dev->pool_size);
 
     return 0;
 }
 
 /* ...allocate output/capture buffer pool */
-static inline int vin_destroy_buffers(int vfd, vin_buffer_t *pool, int num)
+static inline int vin_destroy_buffers(vin_device_t *dev)
 {
     struct v4l2_requestbuffers  reqbuf;
-    int                         j;
+    int                         j, k;
 
     /* ...stop streaming before doing anything */
-    CHK_API(vin_streaming_enable(vfd, 0));
+    CHK_API(vin_streaming_enable(dev, 0));
 
     /* ...unmap all buffers */
-    for (j = 0; j < num; j++)
+    for (j = 0; j < dev->pool_size; j++)
     {
-        munmap(pool[j].data, pool[j].length);
+        for (k = 0; k < dev->n_planes; k++)
+        {
+            munmap(dev->pool[j].data[k], dev->pool[j].length[k]);
+            (dev->pool[j].dmafd[k] >= 0 ? close(dev->pool[j].dmafd[k]) : 0);
+        }
     }
 
     /* ...release kernel-allocated buffers */
     memset(&reqbuf, 0, sizeof(reqbuf));
-    reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    reqbuf.type = dev->type;
     reqbuf.memory = V4L2_MEMORY_MMAP;
     reqbuf.count = 0;
-    CHK_API(ioctl(vfd, VIDIOC_REQBUFS, &reqbuf));
+    CHK_API(ioctl(dev->vfd, VIDIOC_REQBUFS, &reqbuf));
+
+    TRACE(BUFFER, _b("buffer-pool destroyed (%d buffers)"), dev->pool_size);
 
-    TRACE(BUFFER, _b("buffer-pool destroyed (%d buffers)"), num);
+    /* ...destroy pool descriptors */
+    free(dev->pool), dev->pool = NULL;
 
     return 0;
 }
 
 /* ...enqueue output buffer */
-static inline int vin_output_buffer_enqueue(int vfd, int j)
+static inline int vin_output_buffer_enqueue(vin_device_t *dev, int j)
 {
     struct v4l2_buffer  buf;
+    struct v4l2_plane   planes[VIN_MAX_PLANES];
 
     /* ...set buffer parameters */
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
+    __vin_buffer_init(dev, &buf, planes);
     buf.index = j;
-    CHK_API(ioctl(vfd, VIDIOC_QBUF, &buf));
+    CHK_API(ioctl(dev->vfd, VIDIOC_QBUF, &buf));
 
     TRACE(BUFFER, _b("output-buffer #%d queued"), j);
     return 0;
 }
 
-/* ...dequeue input buffer */
-static inline int vin_output_buffer_dequeue(int vfd)
+/* ...dequeue input buffer (buffer descriptor is returned to the caller) */
+static inline int vin_output_buffer_dequeue(vin_device_t *dev, struct v4l2_buffer *buf, struct v4l2_plane *planes)
 {
-    struct v4l2_buffer  buf;
-
     /* ...set buffer parameters */
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    CHK_API(ioctl(vfd, VIDIOC_DQBUF, &buf));
+    __vin_buffer_init(dev, buf, planes);
+    CHK_API(ioctl(dev->vfd, VIDIOC_DQBUF, buf));
 
-    TRACE(BUFFER, _b("output-buffer #%d dequeued"), buf.index);
-    return buf.index;
+    TRACE(BUFFER, _b("output-buffer #%d dequeued (seq=%u, ts=%lu.%06lu)"),
+          buf->index, buf->sequence,
+          (unsigned long)buf->timestamp.tv_sec, (unsigned long)buf->timestamp.tv_usec);
+
+    return buf->index;
+}
+
+/* ...translate driver timestamp into pipeline clock domain ("now" is current clock sample) */
+static inline GstClockTime vin_buffer_timestamp(GstClockTime now, struct v4l2_buffer *buf)
+{
+    struct timespec ts;
+    u64             mono, capture;
+
+    /* ...timestamps not taken from monotonic clock cannot be related to anything */
+    if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) != V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+    {
+        return now;
+    }
+
+    /* ...get current value of monotonic clock */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mono = (u64)ts.tv_sec * GST_SECOND + ts.tv_nsec;
+    capture = (u64)buf->timestamp.tv_sec * GST_SECOND + (u64)buf->timestamp.tv_usec * GST_USECOND;
+
+    /* ...sanity check - capture time cannot be in the future or before clock start */
+    if (capture > mono || mono - capture > now)
+    {
+        return now;
+    }
+
+    /* ...shift pipeline clock sample back by the frame age */
+    return now - (mono - capture);
 }
 
 
@@ -397,36 +634,110 @@ static inline int vin_output_buffer_dequeue(int vfd)
  * V4L2 decoder thread
  ******************************************************************************/
 
+/* ...apply scheduling policy and CPU affinity to the calling thread */
+static void vin_thread_setup(int id)
+{
+    int     cpu = (id >= 0 ? __vin_affinity[id] : __vin_affinity[0]);
+
+    /* ...switch to real-time scheduling if requested */
+    if (__vin_priority > 0)
+    {
+        struct sched_param  param = { .sched_priority = __vin_priority };
+        int                 r;
+
+        if ((r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0)
+        {
+            TRACE(WARNING, _b("vin-thread[%d]: failed to set SCHED_FIFO priority %d: %s"),
+                  id, __vin_priority, strerror(r));
+        }
+    }
+
+    /* ...pin thread to a specified CPU */
+    if (cpu >= 0)
+    {
+        cpu_set_t   set;
+        int         r;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+
+        if ((r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+        {
+            TRACE(WARNING, _b("vin-thread[%d]: failed to set CPU affinity %d: %s"),
+                  id, cpu, strerror(r));
+        }
+    }
+
+    TRACE(INIT, _b("vin-thread[%d]: started (prio=%d, cpu=%d)"),
+          id, __vin_priority, cpu);
+}
+
 /* ...submit buffer to the device (called with a decoder lock held) */
 static inline int __submit_buffer(vin_decoder_t *dec, int i, int j)
 {
-    /* ...submit a buffer */
-    CHK_API(vin_output_buffer_enqueue(dec->dev[i].vfd, j));
+    vin_device_t   *dev = &dec->dev[i];
+    int             r;
+
+    /* ...submit a buffer; device lock is nested into decoder lock */
+    pthread_mutex_lock(&dev->lock);
+    r = vin_output_buffer_enqueue(dev, j);
+    pthread_mutex_unlock(&dev->lock);
+
+    CHK_API(r);
 
     TRACE(BUFFER, _b("camera-%d: enqueue buffer #%d"), i, j);
 
     /* ...notify decoder thread about buffer queueing */
     (dec->output_count++ == 0 ? pthread_cond_signal(&dec->wait) : 0);
 
+    /* ...notify device capture thread as well */
+    (dev->queued++ == 0 ? pthread_cond_signal(&dev->wait) : 0);
+
     return 0;
 }
 
 /* ...buffer processing function */
 static inline int __decoder_process(vin_decoder_t *dec, int i)
 {
-    vin_device_t   *dev = &dec->dev[i];
-    GstBuffer      *buffer;
-    vin_buffer_t   *buf;
-    int             j;
+    vin_device_t       *dev = &dec->dev[i];
+    struct v4l2_buffer  vbuf;
+    struct v4l2_plane   planes[VIN_MAX_PLANES];
+    GstBuffer          *buffer;
+    vin_buffer_t       *buf;
+    int                 j;
 
-    /* ...get internal data access lock */
-    pthread_mutex_lock(&dec->lock);
+    /* ...get buffer from a device; other devices are not blocked */
+    pthread_mutex_lock(&dev->lock);
+
+    if ((j = vin_output_buffer_dequeue(dev, &vbuf, planes)) >= 0)
+    {
+        /* ...counter going backwards (stream restart or wrap) is a resync, not a loss */
+        if (dev->started && (s32)(vbuf.sequence - dev->sequence) <= 0)
+        {
+            TRACE(INFO, _b("camera-%d: sequence resync (seq=%u, last=%u)"), i, vbuf.sequence, dev->sequence);
+        }
+        else if (dev->started && vbuf.sequence != dev->sequence + 1)
+        {
+            /* ...detect frames dropped by the driver (sequence counter gaps) */
+            dev->dropped += vbuf.sequence - dev->sequence - 1;
+
+            TRACE(WARNING, _b("camera-%d: %u frame(s) lost (seq=%u, last=%u, total=%u)"),
+                  i, vbuf.sequence - dev->sequence - 1, vbuf.sequence, dev->sequence, dev->dropped);
+        }
+
+        /* ...save sequence number of last frame */
+        dev->sequence = vbuf.sequence, dev->started = 1;
+    }
+
+    pthread_mutex_unlock(&dev->lock);
 
-    /* ...get buffer from a device */
-    CHK_API(j = vin_output_buffer_dequeue(dev->vfd));
+    CHK_API(j);
+
+    /* ...get shared data access lock */
+    pthread_mutex_lock(&dec->lock);
 
     /* ...atomically decrement number of queued outputs */
-    dec->output_count--;
+    dec->output_count--, dev->queued--;
 
     /* ...pass buffer to the application */
     buffer = (buf = &dev->pool[j])->buffer;
@@ -437,9 +748,16 @@ static inline int __decoder_process(vin_decoder_t *dec, int i)
 
     if (dec->active)
     {
-        /* ...set decoding/presentation timestamp */
-        GST_BUFFER_PTS(buffer) = gst_clock_get_time(GST_ELEMENT_CLOCK(dec->bin));
-        GST_BUFFER_DTS(buffer) = GST_BUFFER_PTS(buffer);
+        GstClockTime    now = gst_clock_get_time(GST_ELEMENT_CLOCK(dec->bin));
+
+        /* ...set presentation timestamp from driver capture time */
+        GST_BUFFER_PTS(buffer) = vin_buffer_timestamp(now, &vbuf);
+
+        /* ...decoding timestamp is a moment the frame has been dequeued */
+        GST_BUFFER_DTS(buffer) = now;
+
+        /* ...pass frame sequence number to allow drop detection downstream */
+        GST_BUFFER_OFFSET(buffer) = vbuf.sequence;
 
         /* ...increment number of buffers submitted */
         dec->output_busy++;
@@ -478,8 +796,8 @@ static void * vin_decode_thread(void *arg)
     struct pollfd      *pfd;
     int                 i;
 
-    /* ...allocate poll descriptors */
-    CHK_ERR(pfd = malloc(sizeof(*pfd) * n), (errno = ENOMEM, NULL));
+    /* ...allocate poll descriptors (with an extra slot for shutdown event) */
+    CHK_ERR(pfd = malloc(sizeof(*pfd) * (n + 1)), (errno = ENOMEM, NULL));
 
     /* ...prepare polling descriptors */
     for (i = 0; i < n; i++)
@@ -488,6 +806,14 @@ static void * vin_decode_thread(void *arg)
         pfd[i].events = POLLIN;
     }
 
+    /* ...shutdown notification descriptor (ignored by poll if negative) */
+    pfd[n].fd = dec->efd;
+    pfd[n].events = POLLIN;
+    pfd[n].revents = 0;
+
+    /* ...apply scheduling parameters */
+    vin_thread_setup(-1);
+
     /* ...start processing loop */
     while (1)
     {
@@ -514,7 +840,7 @@ static void * vin_decode_thread(void *arg)
         TRACE(0, _b("start waiting..."));
 
         /* ...wait for a decoding completion */
-        if ((r = poll(pfd, n, -1)) < 0)
+        if ((r = poll(pfd, n + 1, -1)) < 0)
         {
             /* ...ignore soft interruption (e.g. from gdb) */
             if (errno == EINTR) continue;
@@ -524,6 +850,13 @@ static void * vin_decode_thread(void *arg)
 
         TRACE(0, _b("waiting complete: %d"), r);
 
+        /* ...check for a shutdown request */
+        if (pfd[n].revents & POLLIN)
+        {
+            TRACE(INIT, _b("shutdown event received"));
+            break;
+        }
+
         for (i = 0; i < n; i++)
         {
             /* ...skip item if it's not signalled */
@@ -546,11 +879,107 @@ static void * vin_decode_thread(void *arg)
     return (void *)(intptr_t)-errno;
 }
 
+/* ...per-device capture thread */
+static void * vin_capture_thread(void *arg)
+{
+    vin_device_t       *dev = arg;
+    vin_decoder_t      *dec = dev->dec;
+    struct pollfd       pfd[2];
+
+    /* ...prepare polling descriptors */
+    pfd[0].fd = dev->vfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = dec->efd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+
+    /* ...apply scheduling parameters */
+    vin_thread_setup(dev->id);
+
+    /* ...start processing loop */
+    while (1)
+    {
+        /* ...wait until we have any buffers queued to this device */
+        pthread_mutex_lock(&dec->lock);
+
+        while (dec->active && !dev->queued)
+        {
+            pthread_cond_wait(&dev->wait, &dec->lock);
+        }
+
+        pthread_mutex_unlock(&dec->lock);
+
+        /* ...check if thread needs to be terminated */
+        if (!dec->active)
+        {
+            break;
+        }
+
+        /* ...wait for a frame capturing completion */
+        if (poll(pfd, 2, -1) < 0)
+        {
+            /* ...ignore soft interruption (e.g. from gdb) */
+            if (errno == EINTR) continue;
+            TRACE(ERROR, _x("camera-%d: poll failed: %m"), dev->id);
+            break;
+        }
+
+        /* ...check for a shutdown request (event is not consumed to kick all threads) */
+        if (pfd[1].revents & POLLIN)
+        {
+            break;
+        }
+
+        /* ...retrieve a buffer from device */
+        if ((pfd[0].revents & POLLIN) && __decoder_process(dec, dev->id) < 0)
+        {
+            TRACE(ERROR, _x("camera-%d: processing failed: %m"), dev->id);
+            break;
+        }
+    }
+
+    TRACE(INIT, _b("camera-%d: capture thread exits: %m"), dev->id);
+
+    return (void *)(intptr_t)-errno;
+}
+
+/* ...terminate capturing threads (called with a decoder lock released) */
+static void vin_decoding_stop(vin_decoder_t *dec, int n)
+{
+    int     i;
+
+    /* ...clear activity flag and kick all threads */
+    pthread_mutex_lock(&dec->lock);
+    dec->active = 0;
+    pthread_cond_signal(&dec->wait);
+    for (i = 0; i < dec->number; i++)
+    {
+        pthread_cond_signal(&dec->dev[i].wait);
+    }
+    pthread_mutex_unlock(&dec->lock);
+
+    /* ...wake up threads blocked in poll */
+    (dec->efd >= 0 ? eventfd_write(dec->efd, 1) : 0);
+
+    /* ...wait for a threads completion */
+    if (!dec->threaded)
+    {
+        pthread_join(dec->thread, NULL);
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+        {
+            pthread_join(dec->dev[i].thread, NULL);
+        }
+    }
+}
+
 /* ...start module operation */
 static inline int vin_decoding_start(vin_decoder_t *dec)
 {
     pthread_attr_t  attr;
-    int             r;
+    int             i, r;
 
     /* ...set decoder active flag */
     dec->active = 1;
@@ -560,11 +989,29 @@ static inline int vin_decoding_start(vin_decoder_t *dec)
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
     pthread_attr_setstacksize(&attr, 128 << 10);
 
-    /* ...create decoding thread to asynchronously process JPG frames decoding */
-    r = pthread_create(&dec->thread, &attr, vin_decode_thread, dec);
+    if (!dec->threaded)
+    {
+        /* ...create decoding thread to asynchronously process all devices */
+        r = pthread_create(&dec->thread, &attr, vin_decode_thread, dec);
+    }
+    else
+    {
+        /* ...create capture thread for each device */
+        for (i = 0, r = 0; r == 0 && i < dec->number; i++)
+        {
+            r = pthread_create(&dec->dev[i].thread, &attr, vin_capture_thread, &dec->dev[i]);
+        }
+
+        /* ...in case of failure, stop the threads that are already running */
+        if (r != 0)
+        {
+            vin_decoding_stop(dec, i - 1);
+        }
+    }
+
     pthread_attr_destroy(&attr);
 
-    return CHK_API(r);
+    return CHK_API(-r);
 }
 
 /*******************************************************************************
@@ -625,9 +1072,9 @@ static gboolean __output_buffer_dispose(GstMiniObject *obj)
 
 /* ...runtime initialization */
 static inline int vin_runtime_init(vin_decoder_t *dec,
-        int *vfd, int n, int width, int height, u32 format)
+        int *vfd, int n, int width, int height, u32 format, int num)
 {
-    int     i, j;
+    int     i, j, k;
 
     for (i = 0; i < n; i++)
     {
@@ -636,28 +1083,53 @@ static inline int vin_runtime_init(vin_decoder_t *dec,
         /* ...open associated VIN device */
         CHK_API(dev->vfd = vfd[i]);
 
-        /* ...set VIN format (image parameters are hardcoded - tbd) */
-        CHK_API(vin_set_formats(dev->vfd, width, height, format));
+        /* ...set back-reference to decoder */
+        dev->dec = dec, dev->id = i, dev->queued = 0;
+        pthread_cond_init(&dev->wait, NULL);
+        pthread_mutex_init(&dev->lock, NULL);
+
+        /* ...reset frame sequence tracking */
+        dev->sequence = dev->dropped = 0, dev->started = 0;
+
+        /* ...detect buffer type supported by the device */
+        CHK_API(dev->type = __vin_check_caps(dev->vfd));
+
+        /* ...set VIN format */
+        CHK_API(vin_set_formats(dev, width, height, format));
+
+        /* ...set capturing frame rate if requested */
+        if (__vin_fps > 0)
+        {
+            CHK_API(vin_set_frame_rate(dev, __vin_fps));
+        }
 
         /* ...allocate output buffers */
-        CHK_API(vin_allocate_buffers(dev->vfd, dev->pool, VIN_BUFFER_POOL_SIZE));
+        CHK_API(vin_allocate_buffers(dev, num));
 
         /* ...create gstreamer buffers */
-        for (j = 0; j < VIN_BUFFER_POOL_SIZE; j++)
+        for (j = 0; j < dev->pool_size; j++)
         {
             vin_buffer_t   *buf = &dev->pool[j];
             GstBuffer      *buffer;
             vin_meta_t     *meta;
             vsink_meta_t   *vmeta;
 
-            /* ...allocate GStreamer buffer */
-            CHK_ERR(buf->buffer = buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS,
-                                                                       buf->data,
-                                                                       buf->length * 2,
-                                                                       0,
-                                                                       buf->length,
-                                                                       NULL,
-                                                                       NULL), -ENOMEM);
+            /* ...allocate GStreamer buffer wrapping all memory planes */
+            CHK_ERR(buf->buffer = buffer = gst_buffer_new(), -ENOMEM);
+            for (k = 0; k < dev->n_planes; k++)
+            {
+                GstMemory  *mem;
+
+                CHK_ERR(mem = gst_memory_new_wrapped(GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS,
+                                                     buf->data[k],
+                                                     buf->length[k],
+                                                     0,
+                                                     buf->length[k],
+                                                     NULL,
+                                                     NULL), -ENOMEM);
+                gst_buffer_append_memory(buffer, mem);
+            }
+
             TRACE(BUFFER, _b("new buffer: %p, refcount=%d, format=%s"), buffer, GST_MINI_OBJECT_REFCOUNT(buffer), gst_video_format_to_string (__pixfmt_v4l2_to_gst(format)));
             /* ...add VIN metadata for decoding purposes */
             CHK_ERR(meta = gst_buffer_add_vin_meta(buffer), -ENOMEM);
@@ -672,8 +1144,29 @@ static inline int vin_runtime_init(vin_decoder_t *dec,
             vmeta->format = __pixfmt_v4l2_to_gst(format);
             vmeta->dmafd[0] = -1;
             vmeta->dmafd[1] = -1;
-            vmeta->plane[0] = buf->data;
+
+            /* ...expose exported planes (not used for GPU import; is_dma stays clear) */
+            for (k = 0; k < dev->n_planes && buf->dmafd[k] >= 0; k++)
+            {
+                vmeta->dmafd[k] = buf->dmafd[k], vmeta->n_dma = k + 1;
+            }
+
+            vmeta->plane[0] = buf->data[0];
             vmeta->plane[1] = NULL;
+            vmeta->stride[0] = dev->stride[0];
+
+            /* ...semi-planar formats have separate chroma plane (rows may be padded by driver) */
+            if (format == V4L2_PIX_FMT_NV12 || format == V4L2_PIX_FMT_NV16)
+            {
+                vmeta->n_planes = 2;
+                vmeta->plane[1] = (dev->n_planes > 1 ? buf->data[1] : (u8 *)buf->data[0] + dev->stride[0] * height);
+                vmeta->stride[1] = dev->stride[1];
+            }
+            else
+            {
+                vmeta->n_planes = 1;
+            }
+
             GST_META_FLAG_SET(vmeta, GST_META_FLAG_POOLED);
 
             /* ...modify buffer release callback */
@@ -687,7 +1180,7 @@ static inline int vin_runtime_init(vin_decoder_t *dec,
 
             /* ...submit a buffer into device */
             __submit_buffer(dec, i, j);
-            TRACE(BUFFER, _b("gst buffer %p allocated, data pointer: %p, refcount=%d"), buffer, buf->data, GST_MINI_OBJECT_REFCOUNT(buffer));
+            TRACE(BUFFER, _b("gst buffer %p allocated, data pointer: %p, refcount=%d"), buffer, buf->data[0], GST_MINI_OBJECT_REFCOUNT(buffer));
         }
     }
 
@@ -729,6 +1222,9 @@ static inline void vin_state_changed(GstElement *element,
         /* ...notify decoding thread as required */
         pthread_cond_signal(&dec->wait);
 
+        /* ...wake up capturing threads blocked in poll */
+        (dec->efd >= 0 ? eventfd_write(dec->efd, 1) : 0);
+
         /* ...wait here until all buffers are returned back to pool */
         while (dec->output_busy > 0)
         {
@@ -774,8 +1270,8 @@ static void vin_decoder_destroy(gpointer data, GObject *obj)
     /* ...release decoder access lock to allow thread to finish */
     pthread_mutex_unlock(&dec->lock);
 
-    /* ...wait for a thread completion */
-    pthread_join(dec->thread, NULL);
+    /* ...wait for a threads completion */
+    vin_decoding_stop(dec, dec->number);
 
     TRACE(INIT, _b("decoder thread joined"));
 
@@ -785,7 +1281,7 @@ static void vin_decoder_destroy(gpointer data, GObject *obj)
         vin_device_t   *dev = &dec->dev[i];
         vin_buffer_t   *pool = dev->pool;
 
-        for (j = 0; j < VIN_BUFFER_POOL_SIZE; j++)
+        for (j = 0; j < dev->pool_size; j++)
         {
             GstBuffer  *buffer;
 
@@ -799,12 +1295,19 @@ static void vin_decoder_destroy(gpointer data, GObject *obj)
         }
 
         /* ...deallocate buffers */
-        vin_destroy_buffers(dev->vfd, pool, VIN_BUFFER_POOL_SIZE);
+        vin_destroy_buffers(dev);
 
         /* ...close V4L2 device */
         close(dev->vfd);
+
+        /* ...destroy device conditional variable and lock */
+        pthread_cond_destroy(&dev->wait);
+        pthread_mutex_destroy(&dev->lock);
     }
 
+    /* ...close shutdown notification descriptor */
+    (dec->efd >= 0 ? close(dec->efd) : 0);
+
     /* ...destroy mutex */
     pthread_mutex_destroy(&dec->lock);
 
@@ -837,7 +1340,7 @@ GstElement * camera_vin_create(const camera_callback_t *cb,
     CHK_ERR(dec = malloc(sizeof(*dec)), (errno = ENOMEM, NULL));
 
     /* ...create video-devices data */
-    if ((dec->dev = dev = malloc(n * sizeof(*dev))) == NULL)
+    if ((dec->dev = dev = calloc(n, sizeof(*dev))) == NULL)
     {
         TRACE(ERROR, _x("failed to allocate memory for %u devices"), n);
         errno = ENOMEM;
@@ -873,13 +1376,27 @@ GstElement * camera_vin_create(const camera_callback_t *cb,
     /* ...initialize conditional variable for flushing */
     pthread_cond_init(&dec->flush_wait, NULL);
 
-    /* ...initialize decoder runtime (image size hardcoded for now - tbd) */
+    /* ...set capturing threads mode */
+    dec->threaded = __vin_threads;
+
+    /* ...create shutdown notification descriptor if requested */
+    if (!__vin_eventfd)
+    {
+        dec->efd = -1;
+    }
+    else if ((dec->efd = eventfd(0, EFD_CLOEXEC)) < 0)
+    {
+        TRACE(WARNING, _b("failed to create eventfd: %m"));
+    }
+
+    /* ...initialize decoder runtime */
     if ((errno = -vin_runtime_init(dec,
                                    vfd,
                                    n,
                                    width,
                                    height,
-                                   __gst_to_pixfmt_v4l2(GST_VIDEO_FORMAT_UYVY))) != 0)
+                                   __gst_to_pixfmt_v4l2(__vin_format),
+                                   (__vin_buffers ? : VIN_BUFFER_POOL_SIZE))) != 0)
     {
         TRACE(ERROR, _x("failed to initialize decoder runtime: %m"));
         goto error_bin;
@@ -897,6 +1414,9 @@ GstElement * camera_vin_create(const camera_callback_t *cb,
     return bin;
 
 error_bin:
+    /* ...close shutdown notification descriptor */
+    (dec->efd >= 0 ? close(dec->efd) : 0);
+
     /* ...destroy bin object */
     gst_object_unref(bin);
 
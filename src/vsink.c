@@ -338,6 +338,9 @@ static GstPadProbeReturn vsink_probe(GstPad *pad,
                     sink->pool = pool = NULL;
                     gst_object_unref(allocator);
                     sink->allocator = allocator = NULL;
+
+                    /* ...buffers imported from this pool are not going to be reused */
+                    texture_cache_flush(sink);
                 }
                 else
                 {
@@ -547,6 +550,7 @@ static int vsink_buffer_check(video_sink_t *sink, GstBuffer *buffer)
     meta->width = vmeta->width;
     meta->height = vmeta->height;
     meta->format = vmeta->format;
+    meta->sink = sink;
 
     is_dma = gst_is_dmabuf_memory(gst_buffer_peek_memory(buffer, 0));
     if (is_dma)
@@ -567,6 +571,7 @@ static int vsink_buffer_check(video_sink_t *sink, GstBuffer *buffer)
     for (i = 0; i < vmeta->n_planes; i++)
     {
         mem = gst_buffer_peek_memory(buffer, i);
+        meta->stride[i] = vmeta->stride[i];
         if (is_dma)
         {
             meta->dmafd[i] = gst_dmabuf_memory_get_fd(mem);
@@ -702,6 +707,9 @@ static void vsink_destroy(gpointer data)
         gst_object_unref(sink->pool);
     }
 
+    /* ...drop imported buffers cached on behalf of this sink */
+    texture_cache_flush(sink);
+
     TRACE(INIT, _b("video-sink[%p] deallocate"), sink);
 
     free(sink);
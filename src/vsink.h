@@ -63,6 +63,9 @@ typedef struct vsink_meta
     /* ...plane buffers (data pointers) */
     void               *plane[GST_VIDEO_MAX_PLANES];
 
+    /* ...plane line lengths (bytes; 0 - tightly packed) */
+    int                 stride[GST_VIDEO_MAX_PLANES];
+
     /* is DMA? */
     int is_dma;
     /* ...Number of DMA fds... */